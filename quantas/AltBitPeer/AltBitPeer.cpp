@@ -13,6 +13,9 @@ You should have received a copy of the GNU General Public License along with QUA
 namespace quantas {
 
 	int AltBitPeer::currentTransaction = 1;
+	Counter AltBitPeer::requestsSatisfied = Metrics::instance().counter("requestsSatisfied", false);
+	Counter AltBitPeer::messagesSent = Metrics::instance().counter("messagesSent", false);
+	Gauge AltBitPeer::utility = Metrics::instance().gauge("utility");
 
 	AltBitPeer::~AltBitPeer() {
 
@@ -76,15 +79,7 @@ namespace quantas {
 		}
 	}
 	void AltBitPeer::endOfRound(const vector<Peer<AltBitMessage>*>& _peers) {
-		const vector<AltBitPeer*> peers = reinterpret_cast<vector<AltBitPeer*> const&>(_peers);
-		int satisfied = 0;
-		double messages = 0;
-		for (int i = 0; i < peers.size(); i++) {
-			satisfied += peers[i]->requestsSatisfied;
-			messages += peers[i]->messagesSent;
-		}
-
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["utility"].push_back(satisfied / messages * 100);
+		utility.set(requestsSatisfied.value() / double(messagesSent.value()) * 100);
 	}
 
 	void AltBitPeer::sendMessage(long peer, AltBitMessage message) {
@@ -41,9 +41,11 @@ namespace quantas {
 		// the id of the next transaction to submit
 		static int                      currentTransaction;
 		// number of requests satisfied
-		int requestsSatisfied = 0;
+		static Counter                  requestsSatisfied;
 		// number of messages sent
-		int messagesSent = 0;
+		static Counter                  messagesSent;
+		// percentage of the messages sent that satisfied a request
+		static Gauge                    utility;
 		// message number
 		int ns = 1;
 		// num / den = likelyhood of message getting lost
@@ -14,6 +14,7 @@ namespace quantas {
 
 	int BitcoinPeer::currentTransaction = 1;
 	mutex BitcoinPeer::currentTransaction_mutex;
+	Gauge BitcoinPeer::throughput = Metrics::instance().gauge("throughput");
 
 	BitcoinPeer::~BitcoinPeer() {
 
@@ -38,6 +39,14 @@ namespace quantas {
 			mineBlock();
 	}
 
+	void BitcoinPeer::updateParameters(const vector<Peer<BitcoinMessage>*>& _peers, json parameters) {
+		const vector<BitcoinPeer*> peers = reinterpret_cast<vector<BitcoinPeer*> const&>(_peers);
+		for (BitcoinPeer *peer : peers) {
+			peer->submitRate = parameters.value("submitRate", peer->submitRate);
+			peer->mineRate = parameters.value("mineRate", peer->mineRate);
+		}
+	}
+
 	void BitcoinPeer::endOfRound(const vector<Peer<BitcoinMessage>*>& _peers) {
 		const vector<BitcoinPeer*> peers = reinterpret_cast<vector<BitcoinPeer*> const&>(_peers);
 		int length = peers[0]->blockChain.size();
@@ -48,7 +57,7 @@ namespace quantas {
 				index = i;
 			}
 		}
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["throughput"].push_back(length - 1);
+		throughput.set(length - 1);
 	}
 
 	void BitcoinPeer::checkInStrm() {
@@ -152,6 +161,14 @@ namespace quantas {
 		return nextTransaction;
 	}
 
+	size_t BitcoinPeer::stateBytes()const {
+		size_t bytes = blockChain.capacity() * sizeof(vector<BitcoinBlock>);
+		for (const vector<BitcoinBlock>& chain : blockChain) {
+			bytes += chain.capacity() * sizeof(BitcoinBlock);
+		}
+		return bytes + (unlinkedBlocks.capacity() + transactions.capacity()) * sizeof(BitcoinBlock);
+	}
+
 	ostream& BitcoinPeer::printTo(ostream& out)const {
 		Peer<BitcoinMessage>::printTo(out);
 
@@ -48,6 +48,10 @@ namespace quantas {
         BitcoinPeer(const BitcoinPeer& rhs);
         ~BitcoinPeer();
 
+        // initialize the configuration of the system
+        void                 initParameters(const vector<Peer<BitcoinMessage>*>& _peers, json parameters) { updateParameters(_peers, parameters); };
+        // set submitRate and mineRate of every peer
+        void                 updateParameters(const vector<Peer<BitcoinMessage>*>& _peers, json parameters);
         // perform one step of the Algorithm with the messages in inStream
         void                 performComputation();
         // perform any calculations needed at the end of a round such as determine throughput (only ran once, not for every peer)
@@ -57,6 +61,8 @@ namespace quantas {
         void                 log()const { printTo(*_log); };
         ostream& printTo(ostream&)const;
         friend ostream& operator<<         (ostream&, const BitcoinPeer&);
+        // bytes held by the blockchain and the blocks and transactions received, estimated from the vectors' capacities
+        size_t               stateBytes()const;
 
 
 
@@ -73,6 +79,8 @@ namespace quantas {
         // the id of the next transaction to submit
         static int            currentTransaction;
         static mutex          currentTransaction_mutex;
+        // blocks in the shortest blockchain, which every peer has
+        static Gauge          throughput;
 
         // checkInStrm loops through the in stream adding blocks to unlinked or transactions
         void                  checkInStrm();
@@ -12,15 +12,17 @@ You should have received a copy of the GNU General Public License along with QUA
 
 namespace quantas {
 
+	Counter ChangRobertsPeer::messagesSent = Metrics::instance().counter("messagesSent", false);
+
 	ChangRobertsPeer::~ChangRobertsPeer() {
 
 	}
 
-	ChangRobertsPeer::ChangRobertsPeer(const ChangRobertsPeer& rhs) : Peer<ChangRobertsMessage>(rhs), messages_sent(0), first_elected(false) {
+	ChangRobertsPeer::ChangRobertsPeer(const ChangRobertsPeer& rhs) : Peer<ChangRobertsMessage>(rhs), first_elected(false) {
 		
 	}
 
-	ChangRobertsPeer::ChangRobertsPeer(long id) : Peer(id), messages_sent(0), first_elected(false) {
+	ChangRobertsPeer::ChangRobertsPeer(long id) : Peer(id), first_elected(false) {
 		
 	}
 
@@ -30,7 +32,7 @@ namespace quantas {
 			ChangRobertsMessage msg;
 			msg.aPeerId = id(); 
 			unicast(msg);
-			++messages_sent;
+			messagesSent++;
 		}
 		while (!inStreamEmpty()) {
 			Packet<ChangRobertsMessage> newMsg = popInStream();
@@ -45,26 +47,24 @@ namespace quantas {
 					ChangRobertsMessage msg;
 					msg.aPeerId = rid;
 					broadcastBut(msg,sid);
-					++messages_sent;
+					messagesSent++;
 				}
 			}	
 		}
 	}
 
 	void ChangRobertsPeer::endOfRound(const vector<Peer<ChangRobertsMessage>*>& _peers) {
-		long all_messages_sent = 0;
 		bool elected = false;
 		long elected_id = -1;
 		const vector<ChangRobertsPeer*> peers = reinterpret_cast<vector<ChangRobertsPeer*> const&>(_peers);
 		for(auto it = peers.begin(); it != peers.end(); ++it) {
-			all_messages_sent += (*it)->messages_sent;
 			if((*it)->first_elected) {
 				elected = true;
 				elected_id = (*it)->id();
 			}
 		}
 		if(elected) {
-			LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["nb_messages"] = all_messages_sent;
+			LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["nb_messages"] = messagesSent.value();
 			LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["election_time"] = getRound();
 			LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["elected_id"] = elected_id;
 		}
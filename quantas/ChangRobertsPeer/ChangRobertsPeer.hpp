@@ -47,7 +47,8 @@ namespace quantas{
 
     private:
         bool first_elected;
-        long messages_sent;
+        // number of messages sent by every peer this test
+        static Counter messagesSent;
     };
 
     Simulation<quantas::ChangRobertsMessage, quantas::ChangRobertsPeer>* generateSim();
@@ -0,0 +1,293 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class is the binary file a simulation is saved to and restored from. The same code does
+// both: `archive & value` writes value when saving and reads it back when restoring, so a type
+// only has to list its fields once, in a member
+//
+//     void serialize(Checkpoint &archive) { archive & field1 & field2; }
+//
+// Trivially copyable types are copied byte for byte, standard containers, strings and json
+// element by element. A value of any other type without a serialize member marks the archive as
+// unsupported rather than failing to compile, as every peer and message type instantiates the
+// checkpoint code whether or not it opts in.
+//
+// Layout (native endianness): magic "QCKP", version, then the values in the order they were saved.
+//
+// A damaged file fails the archive rather than the process: the element counts of containers are
+// checked against the bytes left to read before anything is allocated for them.
+
+#ifndef Checkpoint_hpp
+#define Checkpoint_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <typeinfo>
+#include <stdexcept>
+#include <type_traits>
+#include "Json.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class Checkpoint;
+
+    // true if T has a member void serialize(Checkpoint&)
+    template<class T, class = void>
+    struct hasSerialize : std::false_type {};
+    template<class T>
+    struct hasSerialize<T, std::void_t<decltype(std::declval<T&>().serialize(std::declval<Checkpoint&>()))>> : std::true_type {};
+
+    template<class T> void checkpointValue(Checkpoint&, T&);
+    inline void checkpointValue(Checkpoint&, string&);
+    inline void checkpointValue(Checkpoint&, json&);
+    inline void checkpointValue(Checkpoint&, vector<bool>&);
+    template<class T, class A> void checkpointValue(Checkpoint&, vector<T, A>&);
+    template<class T, class A> void checkpointValue(Checkpoint&, std::deque<T, A>&);
+    template<class T, class A> void checkpointValue(Checkpoint&, std::list<T, A>&);
+    template<class K, class V, class C, class A> void checkpointValue(Checkpoint&, std::map<K, V, C, A>&);
+    template<class K, class C, class A> void checkpointValue(Checkpoint&, std::set<K, C, A>&);
+    template<class K, class V, class H, class E, class A> void checkpointValue(Checkpoint&, std::unordered_map<K, V, H, E, A>&);
+    template<class K, class H, class E, class A> void checkpointValue(Checkpoint&, std::unordered_set<K, H, E, A>&);
+    template<class F, class S> void checkpointValue(Checkpoint&, std::pair<F, S>&);
+
+    class Checkpoint {
+    public:
+        static const uint32_t   MAGIC   = 0x504b4351; // "QCKP"
+        static const uint32_t   VERSION = 4;
+
+        enum Mode { SAVE, RESTORE };
+
+        // opens path for writing or reading, throws std::runtime_error if it cannot
+        Checkpoint                          (const string &path, Mode mode);
+
+        bool                    saving      ()const                 {return _mode == SAVE;};
+        bool                    restoring   ()const                 {return _mode == RESTORE;};
+        // false once a read or write failed, or a value could not be saved
+        bool                    good        ()const                 {return _error.empty() && !_file.fail();};
+        string                  error       ()const                 {return _error.empty() && _file.fail() ? "cannot " + string(saving() ? "write " : "read ") + _path : _error;};
+        // records why the simulation cannot be saved or restored, the first reason is kept
+        void                    fail        (const string &why)     {if (_error.empty()) _error = why;};
+
+        template<class T>
+        Checkpoint&             operator&   (T &value)              {if (good()) checkpointValue(*this, value); return *this;};
+        void                    bytes       (void *data, size_t size);
+        // the bytes left to read when restoring
+        uint64_t                remaining   ();
+        // random engines, through their text representation
+        template<class Engine>
+        void                    engine      (Engine &generator);
+
+    private:
+        Mode                    _mode;
+        string                  _path;
+        std::fstream            _file;
+        uint64_t                _size = 0;
+        string                  _error;
+    };
+
+    inline Checkpoint::Checkpoint(const string &path, Mode mode) : _mode(mode), _path(path) {
+        _file.open(path, std::ios::binary | (mode == SAVE ? std::ios::out | std::ios::trunc : std::ios::in));
+        if (_file.fail()) {
+            throw std::runtime_error("cannot open checkpoint " + path);
+        }
+        if (restoring()) {
+            _file.seekg(0, std::ios::end);
+            _size = (uint64_t)_file.tellg();
+            _file.seekg(0, std::ios::beg);
+        }
+        uint32_t magic = MAGIC, version = VERSION;
+        *this & magic & version;
+        if (restoring() && (!good() || magic != MAGIC || version != VERSION)) {
+            throw std::runtime_error(path + " is not a QUANTAS checkpoint");
+        }
+    }
+
+    inline void Checkpoint::bytes(void *data, size_t size) {
+        if (saving()) {
+            _file.write(static_cast<const char*>(data), size);
+        }
+        else {
+            _file.read(static_cast<char*>(data), size);
+        }
+    }
+
+    inline uint64_t Checkpoint::remaining() {
+        std::streamoff position = _file.tellg();
+        return position < 0 || (uint64_t)position > _size ? 0 : _size - (uint64_t)position;
+    }
+
+    template<class Engine>
+    void Checkpoint::engine(Engine &generator) {
+        string state;
+        if (saving()) {
+            std::ostringstream out;
+            out << generator;
+            state = out.str();
+        }
+        *this & state;
+        if (restoring() && good()) {
+            std::istringstream in(state);
+            in >> generator;
+        }
+    }
+
+    template<class T>
+    void checkpointValue(Checkpoint &archive, T &value) {
+        if constexpr (hasSerialize<T>::value) {
+            value.serialize(archive);
+        }
+        else if constexpr (std::is_trivially_copyable<T>::value) {
+            archive.bytes(&value, sizeof(T));
+        }
+        else {
+            archive.fail(string("values of type ") + typeid(T).name() + " cannot be checkpointed");
+        }
+    }
+
+    // the number of elements of a container, as the same type on every platform. Each element
+    // takes at least elementBytes in the file, so a count that cannot fit what is left is damage
+    inline size_t checkpointSize(Checkpoint &archive, size_t size, size_t elementBytes = 1) {
+        uint64_t count = size;
+        archive & count;
+        if (archive.restoring() && archive.good() && count > archive.remaining() / elementBytes) {
+            archive.fail("the checkpoint is damaged, it has " + std::to_string(count) + " elements where " + std::to_string(archive.remaining()) + " bytes are left");
+        }
+        return archive.good() ? (size_t)count : 0;
+    }
+
+    inline void checkpointValue(Checkpoint &archive, string &value) {
+        value.resize(checkpointSize(archive, value.size()));
+        archive.bytes(&value[0], value.size());
+    }
+
+    // json is stored as CBOR, which is smaller than its text and reads back exactly
+    inline void checkpointValue(Checkpoint &archive, json &value) {
+        vector<uint8_t> encoded;
+        if (archive.saving()) {
+            encoded = json::to_cbor(value);
+        }
+        archive & encoded;
+        if (archive.restoring() && archive.good()) {
+            json decoded = json::from_cbor(encoded, true, false);
+            bool valid = !decoded.is_discarded();
+            // CBOR does not check that strings are UTF-8, which printing the log later requires
+            try {
+                valid = valid && !decoded.dump().empty();
+            }
+            catch (const json::exception &) {
+                valid = false;
+            }
+            if (!valid) {
+                archive.fail("the checkpoint is damaged, its json cannot be read");
+                return;
+            }
+            value = std::move(decoded);
+        }
+    }
+
+    inline void checkpointValue(Checkpoint &archive, vector<bool> &value) {
+        value.resize(checkpointSize(archive, value.size()));
+        for (size_t i = 0; i < value.size(); i++) {
+            bool bit = value[i];
+            archive & bit;
+            value[i] = bit;
+        }
+    }
+
+    template<class T, class A>
+    void checkpointValue(Checkpoint &archive, vector<T, A> &value) {
+        constexpr bool raw = std::is_trivially_copyable<T>::value && !hasSerialize<T>::value;
+        value.resize(checkpointSize(archive, value.size(), raw ? sizeof(T) : 1));
+        if constexpr (raw) {
+            archive.bytes(value.data(), value.size() * sizeof(T));
+        }
+        else {
+            for (T &element : value) {
+                archive & element;
+            }
+        }
+    }
+
+    template<class T, class A>
+    void checkpointValue(Checkpoint &archive, std::deque<T, A> &value) {
+        value.resize(checkpointSize(archive, value.size()));
+        for (T &element : value) {
+            archive & element;
+        }
+    }
+
+    template<class T, class A>
+    void checkpointValue(Checkpoint &archive, std::list<T, A> &value) {
+        value.resize(checkpointSize(archive, value.size()));
+        for (T &element : value) {
+            archive & element;
+        }
+    }
+
+    // associative containers are saved as their sequence of elements and rebuilt from it
+    template<class Container, class Element>
+    void checkpointElements(Checkpoint &archive, Container &value) {
+        size_t count = checkpointSize(archive, value.size());
+        if (archive.saving()) {
+            for (const auto &element : value) {
+                Element copy = element;
+                archive & copy;
+            }
+        }
+        else {
+            value.clear();
+            for (size_t i = 0; i < count && archive.good(); i++) {
+                Element element;
+                archive & element;
+                value.insert(value.end(), std::move(element));
+            }
+        }
+    }
+
+    template<class K, class V, class C, class A>
+    void checkpointValue(Checkpoint &archive, std::map<K, V, C, A> &value) {
+        checkpointElements<std::map<K, V, C, A>, std::pair<K, V>>(archive, value);
+    }
+
+    template<class K, class C, class A>
+    void checkpointValue(Checkpoint &archive, std::set<K, C, A> &value) {
+        checkpointElements<std::set<K, C, A>, K>(archive, value);
+    }
+
+    template<class K, class V, class H, class E, class A>
+    void checkpointValue(Checkpoint &archive, std::unordered_map<K, V, H, E, A> &value) {
+        checkpointElements<std::unordered_map<K, V, H, E, A>, std::pair<K, V>>(archive, value);
+    }
+
+    template<class K, class H, class E, class A>
+    void checkpointValue(Checkpoint &archive, std::unordered_set<K, H, E, A> &value) {
+        checkpointElements<std::unordered_set<K, H, E, A>, K>(archive, value);
+    }
+
+    template<class F, class S>
+    void checkpointValue(Checkpoint &archive, std::pair<F, S> &value) {
+        archive & value.first & value.second;
+    }
+}
+
+#endif /* Checkpoint_hpp */
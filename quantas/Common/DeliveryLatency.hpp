@@ -0,0 +1,138 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class measures how many rounds packets take from being sent to being delivered, when an
+// experiment asks for it with
+//
+//     "latency": true
+//
+// Receive records each packet it moves to an inStream into histograms of the Metrics registry, so
+// they are logged with the other metrics, every "interval" rounds, as name.count, .mean, .p50,
+// .p90, .p99 and .max:
+//
+//     delivery.latency        the rounds from the one the packet was sent in to its delivery
+//     delivery.queueing       the rounds of that spent behind earlier packets of its channel, which
+//                             are delivered first, after its own delay had passed
+//     delivery.class.k        the latency of the packets of channels with delay class k, the entry
+//                             of the network's DelayTable (0 for the experiment's distribution)
+//     delivery.type.name      the latency of the messages whose messageType (or action) is name
+//
+// Packets a peer sends itself skip the channels and are not measured. The histograms of the
+// classes and types are registered the first time a thread delivers one of them, each thread
+// keeping the handles it has used.
+
+#ifndef DeliveryLatency_hpp
+#define DeliveryLatency_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include "Json.hpp"
+#include "Metrics.hpp"
+#include "Tracer.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class DeliveryLatency {
+    public:
+        // latency is the experiment's "latency", measuring is off without it
+        static void             configure       (const json &latency);
+        static bool             enabled         ()                      {return _enabled.load(std::memory_order_relaxed);};
+
+        // called by receive for a packet of a channel of delay class channelClass, delivered in round
+        template<class message>
+        static void             delivered       (int round, int channelClass, int sent, int delay, const message &body);
+
+    private:
+        static std::atomic<bool> _enabled;
+        static std::atomic<uint64_t> _generation;
+        static Histogram        _latency;
+        static Histogram        _queueing;
+
+        // the calling thread's handle of the histogram of channelClass, or of the type name
+        static Histogram        ofClass         (int channelClass);
+        static Histogram        ofType          (const string &name);
+    };
+
+    inline std::atomic<bool> DeliveryLatency::_enabled {false};
+    inline std::atomic<uint64_t> DeliveryLatency::_generation {0};
+    inline Histogram DeliveryLatency::_latency;
+    inline Histogram DeliveryLatency::_queueing;
+
+    inline void DeliveryLatency::configure(const json &latency) {
+        bool enabled = latency.is_object() || (latency.is_boolean() && latency.get<bool>());
+        // the registry outlives the experiment, so the histograms an earlier one registered are
+        // muted rather than logged as zeros when this one does not measure
+        Metrics::instance().setLogged("delivery.", enabled);
+        if (enabled) {
+            _latency = Metrics::instance().histogram("delivery.latency");
+            _queueing = Metrics::instance().histogram("delivery.queueing");
+        }
+        ++_generation;
+        _enabled = enabled;
+    }
+
+    inline Histogram DeliveryLatency::ofClass(int channelClass) {
+        thread_local uint64_t generation = 0;
+        thread_local vector<Histogram> known;
+        thread_local vector<bool> registered;
+        if (generation != _generation.load(std::memory_order_relaxed)) {
+            generation = _generation.load(std::memory_order_relaxed);
+            known.clear();
+            registered.clear();
+        }
+        if (channelClass >= (int)known.size()) {
+            known.resize(channelClass + 1);
+            registered.resize(channelClass + 1, false);
+        }
+        if (!registered[channelClass]) {
+            known[channelClass] = Metrics::instance().histogram("delivery.class." + std::to_string(channelClass));
+            registered[channelClass] = true;
+        }
+        return known[channelClass];
+    }
+
+    inline Histogram DeliveryLatency::ofType(const string &name) {
+        thread_local uint64_t generation = 0;
+        thread_local std::unordered_map<string, Histogram> known;
+        if (generation != _generation.load(std::memory_order_relaxed)) {
+            generation = _generation.load(std::memory_order_relaxed);
+            known.clear();
+        }
+        auto found = known.find(name);
+        if (found != known.end()) {
+            return found->second;
+        }
+        Histogram histogram = Metrics::instance().histogram("delivery.type." + name);
+        known[name] = histogram;
+        return histogram;
+    }
+
+    template<class message>
+    void DeliveryLatency::delivered(int round, int channelClass, int sent, int delay, const message &body) {
+        int latency = round - sent;
+        _latency.record(latency);
+        _queueing.record(latency - delay);
+        ofClass(channelClass).record(latency);
+        if constexpr (hasMessageType<message>::value) {
+            ofType(body.messageType).record(latency);
+        }
+        else if constexpr (hasAction<message>::value) {
+            ofType(body.action).record(latency);
+        }
+    }
+}
+
+#endif /* DeliveryLatency_hpp */
@@ -6,6 +6,9 @@ namespace quantas
     
     thread_local default_random_engine RANDOM_GENERATOR =
         default_random_engine(static_cast<int>(time(nullptr))+_hasher(std::this_thread::get_id()));
+
+    thread_local BatchGenerator BATCH_GENERATOR = BatchGenerator(
+        (static_cast<uint64_t>(time(nullptr)) << 32) ^ _hasher(std::this_thread::get_id()));
     
     int uniformInt(const int min, const int max)
     {
@@ -7,22 +7,34 @@ QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRA
 You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
 */
 
-// This class handles the distribution of channel delays in the network. The distribution can be uniform, Poisson or one. 
+// This class handles the distribution of channel delays in the network. The distribution can be uniform, Poisson, one,
+// or empirical (drawn from a measured histogram of delays). It is drawn from once per channel, for the channel's
+// maximum delay; the delays of the channel's packets are uniform up to that maximum (see getUniformDelays).
+// A network may use several of them, see DelayTable below.
 
 
 #ifndef Distribution_hpp
 #define Distribution_hpp
 
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
 #include <random>
+#include <cmath>
+#include <cctype>
+#include <fstream>
+#include <sstream>
 #include <iostream>
 #include <thread>
+#include <algorithm>
 #include "Json.hpp"
 
 
 namespace quantas{
 
     using std::string;
+    using std::vector;
     using std::uniform_int_distribution;
     using std::poisson_distribution;
     using std::default_random_engine;
@@ -42,15 +54,130 @@ namespace quantas{
     // exclusiveMax, but thread-safe)
     int randMod(const int exclusiveMax);
 
-    static const string                POISSON = "POISSON";
-    static const string                UNIFORM = "UNIFORM";
-    static const string                ONE     = "ONE";
+    // Generator for drawing many random numbers at once. The i-th number of a batch is the
+    // splitmix64 hash of a counter, so the numbers of a batch do not depend on each other and
+    // the loop filling them vectorizes.
+    class BatchGenerator {
+    private:
+        uint64_t                            _counter;
+
+    public:
+        explicit BatchGenerator                                      (uint64_t seed) : _counter(seed) {};
+
+        uint64_t                            state               ()const                                         {return _counter;};
+
+        void                                fill                (uint64_t *out, size_t n);
+    };
+
+    inline void BatchGenerator::fill(uint64_t *out, size_t n) {
+        const uint64_t base = _counter;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t z = base + (i + 1) * 0x9e3779b97f4a7c15ULL;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            out[i] = z ^ (z >> 31);
+        }
+        _counter = base + n * 0x9e3779b97f4a7c15ULL;
+    }
+
+    // batch generator created and seeded once in each thread, like RANDOM_GENERATOR
+    extern thread_local BatchGenerator BATCH_GENERATOR;
+
+    // maps a 64-bit random number to [low, high] by multiplying its top half by the range
+    inline int scaleToRange(uint64_t random, int low, int high) {
+        return low + (int)(((random >> 32) * (uint64_t)(uint32_t)(high - low + 1)) >> 32);
+    }
+
+    static const string                POISSON   = "POISSON";
+    static const string                UNIFORM   = "UNIFORM";
+    static const string                ONE       = "ONE";
+    static const string                EMPIRICAL = "EMPIRICAL";
+
+    // Walker's alias method: draws index i with probability weights[i] / sum(weights) in
+    // constant time, from one table lookup and one biased coin.
+    class AliasTable {
+    private:
+        vector<double>                      _probability;
+        vector<uint32_t>                    _alias;
+
+    public:
+        AliasTable                                                   () {};
+        AliasTable                                                   (const vector<double> &weights);
+
+        size_t                              size                ()const                                         {return _probability.size();};
+        template<class Generator>
+        size_t                              sample              (Generator&)const;
+    };
+
+    inline AliasTable::AliasTable(const vector<double> &weights) {
+        size_t n = weights.size();
+        double total = 0;
+        for (double weight : weights) {
+            total += weight;
+        }
+        if (n == 0 || total <= 0) {
+            return;
+        }
+        _probability.resize(n);
+        _alias.resize(n);
+        vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; i++) {
+            _probability[i] = weights[i] * n / total;
+            (_probability[i] < 1 ? small : large).push_back((uint32_t)i);
+        }
+        // pair each underfull column with an overfull one that tops it up
+        while (!small.empty() && !large.empty()) {
+            uint32_t under = small.back();
+            uint32_t over = large.back();
+            small.pop_back();
+            _alias[under] = over;
+            _probability[over] -= 1 - _probability[under];
+            if (_probability[over] < 1) {
+                large.pop_back();
+                small.push_back(over);
+            }
+        }
+        // whatever is left is full up to rounding error
+        for (uint32_t i : large) {
+            _probability[i] = 1;
+        }
+        for (uint32_t i : small) {
+            _probability[i] = 1;
+        }
+    }
+
+    template<class Generator>
+    size_t AliasTable::sample(Generator &generator)const {
+        uniform_int_distribution<size_t> column(0, _probability.size() - 1);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        size_t i = column(generator);
+        return coin(generator) < _probability[i] ? i : _alias[i];
+    }
+
     class Distribution {
     private:
+        // the type, resolved once so that drawing a delay does not compare strings
+        enum Kind { ONE_DELAY, UNIFORM_DELAY, POISSON_DELAY, EMPIRICAL_DELAY };
+
         int                                 _avgDelay = 1;
         int                                 _maxDelay = 1;
         int                                 _minDelay = 1;
         string                              _type = ONE;
+        Kind                                _kind = ONE_DELAY;
+        // salt mixed into every channel delay, redrawn for each test
+        unsigned long long                  _channelSeed = 0;
+        // measured delays and how often each was seen, for EMPIRICAL
+        vector<std::pair<int, double> >     _histogram;
+        // the delays that can be drawn, [_low, _high], and for POISSON and EMPIRICAL a table of
+        // their probabilities truncated to that range
+        int                                 _low = 1;
+        int                                 _high = 1;
+        vector<int>                         _values;
+        AliasTable                          _table;
+
+        // rebuilds the table after the parameters change
+        void                                prepare             ();
+        bool                                readHistogram       (json distribution);
 
     public:
         Distribution                                                 () {
@@ -58,6 +185,7 @@ namespace quantas{
             _maxDelay = 1;
             _minDelay = 1;
             _type = UNIFORM;
+            _kind = UNIFORM_DELAY;
         }
 
         Distribution                                                 (const Distribution&);
@@ -66,13 +194,24 @@ namespace quantas{
         // setters
         
         void                                setDistribution     (json distribution);
+        void                                reseedChannels      ()                                              {_channelSeed = RANDOM_GENERATOR();};
 
         // getters
         int                                 maxDelay            ()const                                         {return _maxDelay;};
         int                                 avgDelay            ()const                                         {return _avgDelay;};
         int                                 minDelay            ()const                                         {return _minDelay;};
         string                              type                ()const                                         {return _type;};
-        int                                 getDelay();
+        unsigned long long                  channelSeed         ()const                                         {return _channelSeed;};
+        void                                setChannelSeed      (unsigned long long seed)                       {_channelSeed = seed;};
+        int                                 getDelay            ()                                              {return getDelay(RANDOM_GENERATOR);};
+        // a delay in [max(1, minDelay), maxDelay], in constant time whatever the type
+        template<class Generator>
+        int                                 getDelay            (Generator&)const;
+        // delay of the channel between two peers, the same whichever end asks for it
+        int                                 getChannelDelay     (long, long)const;
+
+        // fills delays[i] with a delay drawn uniformly from [low[i], high[i]], for i in [0, n)
+        static void                         getUniformDelays    (const int *low, const int *high, int *delays, size_t n);
 
     };
 
@@ -85,6 +224,13 @@ namespace quantas{
         _maxDelay = rhs._maxDelay;
         _minDelay = rhs._minDelay;
         _type = rhs._type;
+        _kind = rhs._kind;
+        _channelSeed = rhs._channelSeed;
+        _histogram = rhs._histogram;
+        _low = rhs._low;
+        _high = rhs._high;
+        _values = rhs._values;
+        _table = rhs._table;
     }
 
     inline Distribution::~Distribution(){
@@ -104,34 +250,243 @@ namespace quantas{
 
         if (distribution.contains("type")) {
             string type = distribution["type"];
+            std::transform(type.begin(), type.end(), type.begin(), ::toupper);
             if (type == UNIFORM) {
                 _type = UNIFORM;
+                _kind = UNIFORM_DELAY;
             }
             else if (type == POISSON) {
                 _type = POISSON;
+                _kind = POISSON_DELAY;
             }
             else if (type == ONE) {
                 _type = ONE;
+                _kind = ONE_DELAY;
+            }
+            else if (type == EMPIRICAL) {
+                _type = EMPIRICAL;
+                _kind = EMPIRICAL_DELAY;
+            }
+            else {
+                cerr << "Error: unknown delay distribution " << type << std::endl;
+            }
+        }
+        if (distribution.contains("histogram") || distribution.contains("histogramFile")) {
+            if (readHistogram(distribution) && !_histogram.empty()) {
+                // the histogram gives the range of delays unless it is narrowed explicitly
+                if (!distribution.contains("minDelay")) {
+                    _minDelay = _histogram.front().first;
+                }
+                if (!distribution.contains("maxDelay")) {
+                    _maxDelay = _histogram.back().first;
+                }
+            }
+        }
+        prepare();
+    }
+
+    // A histogram is a list of [delay, count] pairs, inline as "histogram" or in the text file
+    // "histogramFile" with one "delay count" pair per line.
+    inline bool Distribution::readHistogram(json distribution) {
+        vector<std::pair<int, double> > histogram;
+        if (distribution.contains("histogram")) {
+            for (json &bin : distribution["histogram"]) {
+                histogram.push_back({bin[0], bin[1]});
+            }
+        }
+        else {
+            string path = distribution["histogramFile"];
+            std::ifstream in(path);
+            if (in.fail()) {
+                cerr << "Error: cannot open delay histogram " << path << std::endl;
+                return false;
+            }
+            string line;
+            while (std::getline(in, line)) {
+                std::istringstream fields(line);
+                int delay;
+                double count;
+                if (line.empty() || line[0] == '#' || !(fields >> delay >> count)) {
+                    continue;
+                }
+                histogram.push_back({delay, count});
+            }
+        }
+        std::sort(histogram.begin(), histogram.end());
+        _histogram.clear();
+        for (const auto &bin : histogram) {
+            if (!_histogram.empty() && _histogram.back().first == bin.first) {
+                _histogram.back().second += bin.second;
+            }
+            else if (bin.second > 0) {
+                _histogram.push_back(bin);
+            }
+        }
+        return true;
+    }
+
+    // The old sampler drew from the whole distribution and retried until the delay fell in
+    // [max(1, minDelay), maxDelay]. Drawing from the distribution truncated to that range gives
+    // the same delays without the retries.
+    inline void Distribution::prepare() {
+        _low = std::max(1, _minDelay);
+        _high = std::max(_low, _maxDelay);
+        _values.clear();
+        vector<double> weights;
+        if (_kind == POISSON_DELAY) {
+            // beyond mean + 12 deviations the probabilities are far below double precision
+            double mean = std::max(_avgDelay, 0);
+            double tail = mean + 12 * std::sqrt(mean) + 32;
+            int high = (int)std::min<double>(_high, std::max<double>(_low, tail));
+            // log of the Poisson probabilities, scaled by the largest one so that none underflows
+            vector<double> logWeights;
+            for (int k = _low; k <= high; k++) {
+                logWeights.push_back(mean > 0 ? k * std::log(mean) - std::lgamma(k + 1.0) : (k == 0 ? 0.0 : -INFINITY));
+                _values.push_back(k);
+            }
+            double largest = *std::max_element(logWeights.begin(), logWeights.end());
+            for (double logWeight : logWeights) {
+                // with a mean of 0 no delay in range is possible, fall back to the smallest
+                weights.push_back(std::isfinite(largest) ? std::exp(logWeight - largest) : (weights.empty() ? 1.0 : 0.0));
+            }
+        }
+        else if (_kind == EMPIRICAL_DELAY) {
+            for (const auto &bin : _histogram) {
+                if (bin.first >= _low && bin.first <= _high) {
+                    _values.push_back(bin.first);
+                    weights.push_back(bin.second);
+                }
             }
         }
+        _table = AliasTable(weights);
+        if (_table.size() == 0) {
+            _values.clear();
+        }
     }
-    
-    inline int Distribution::getDelay(){
-        int delay = -1;
-        do {
-            if (_type == UNIFORM) {
-                delay = uniformInt(_minDelay, _maxDelay);
+
+    template<class Generator>
+    int Distribution::getDelay(Generator& generator)const{
+        switch (_kind) {
+            case UNIFORM_DELAY: {
+                uniform_int_distribution<int> uniformDistribution(_low, _high);
+                return uniformDistribution(generator);
             }
-            if (_type == POISSON) {
-                poisson_distribution<int> poissonDistribution(_avgDelay);
-                delay = poissonDistribution(RANDOM_GENERATOR);
+            case POISSON_DELAY:
+            case EMPIRICAL_DELAY:
+                // an empty table means no delay in range had any probability
+                return _values.empty() ? _low : _values[_table.sample(generator)];
+            default:
+                return _low;
+        }
+    }
+
+    inline void Distribution::getUniformDelays(const int *low, const int *high, int *delays, size_t n){
+        static thread_local vector<uint64_t> random;
+        random.resize(n);
+        BATCH_GENERATOR.fill(random.data(), n);
+        for (size_t i = 0; i < n; i++) {
+            delays[i] = scaleToRange(random[i], low[i], high[i]);
+        }
+    }
+
+    // Channels are opened from several threads at once, and lazily when a neighbor is added
+    // mid-run, so neither end can wait for the other to draw the delay. Instead the generator
+    // is seeded from the unordered pair of ids and the per-test channel seed.
+    inline int Distribution::getChannelDelay(long a, long b)const{
+        unsigned long long key = _channelSeed;
+        for (unsigned long long v : {(unsigned long long)std::min(a, b), (unsigned long long)std::max(a, b)}) {
+            // splitmix64 finalizer
+            key += v + 0x9e3779b97f4a7c15ULL;
+            key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+            key ^= key >> 31;
+        }
+        default_random_engine generator(static_cast<default_random_engine::result_type>(key));
+        return getDelay(generator);
+    }
+
+    // The delay parameters of one channel: the index of its distribution in the network's
+    // DelayTable and the maximum delay drawn for the channel, four bytes in all.
+    struct ChannelDelay {
+        uint16_t                            distribution = 0;
+        uint16_t                            maxDelay = 1;
+    };
+
+    // The distributions of a network's channels. Entry 0 is the experiment's "distribution",
+    // entry k is the k-th object of its "channels" list, which overrides the fields it gives:
+    //
+    //   "distribution": {"type": "UNIFORM", "maxDelay": 2,
+    //                    "channels": [{"maxDelay": 20, "minDelay": 5, "edges": [[0, 1], [4, 7]]}]}
+    //
+    // A channel takes the entry whose "edges" list its two ends, or the class the edge file gives
+    // its edge, and entry 0 otherwise.
+    class DelayTable {
+    private:
+        vector<Distribution>                _distributions = vector<Distribution>(1);
+        // entry of the channels listed in the configuration, by unordered pair of ids
+        std::unordered_map<uint64_t, uint16_t> _listed;
+
+        static uint64_t                     pairKey             (long a, long b)                                {return (uint64_t)std::min(a, b) << 32 | (uint32_t)std::max(a, b);};
+
+    public:
+        void                                setDistribution     (json distribution);
+        void                                reseedChannels      ()                                              {for (Distribution &d : _distributions) d.reseedChannels();};
+        // the seeds of the channel delays, to checkpoint them
+        vector<unsigned long long>          channelSeeds        ()const;
+        void                                setChannelSeeds     (const vector<unsigned long long> &seeds);
+
+        size_t                              size                ()const                                         {return _distributions.size();};
+        const Distribution&                 operator[]          (size_t i)const                                 {return _distributions[i];};
+        // parameters of the channel between a and b, the same whichever end asks for them. Entry 0
+        // (or none) means the one listed in the configuration, if any.
+        ChannelDelay                        channelDelay        (long a, long b, int entry = 0)const;
+    };
+
+    inline void DelayTable::setDistribution(json distribution) {
+        _distributions.resize(1);
+        _distributions[0].setDistribution(distribution);
+        _listed.clear();
+        if (!distribution.contains("channels")) {
+            return;
+        }
+        for (json &channels : distribution["channels"]) {
+            if (_distributions.size() > UINT16_MAX) {
+                cerr << "Error: too many channel distributions" << std::endl;
+                break;
             }
-            if (_type == ONE) {
-                delay = 1;
+            uint16_t entry = (uint16_t)_distributions.size();
+            _distributions.push_back(_distributions[0]);
+            _distributions.back().setDistribution(channels);
+            if (channels.contains("edges")) {
+                for (json &edge : channels["edges"]) {
+                    _listed[pairKey(edge[0], edge[1])] = entry;
+                }
             }
-            // guard agenst 0 and negative numbers
-        } while (delay < 1 || delay > _maxDelay || delay < _minDelay);
+        }
+    }
 
+    inline vector<unsigned long long> DelayTable::channelSeeds()const {
+        vector<unsigned long long> seeds;
+        for (const Distribution &d : _distributions) {
+            seeds.push_back(d.channelSeed());
+        }
+        return seeds;
+    }
+
+    inline void DelayTable::setChannelSeeds(const vector<unsigned long long> &seeds) {
+        for (size_t i = 0; i < seeds.size() && i < _distributions.size(); i++) {
+            _distributions[i].setChannelSeed(seeds[i]);
+        }
+    }
+
+    inline ChannelDelay DelayTable::channelDelay(long a, long b, int entry)const {
+        ChannelDelay delay;
+        if (entry <= 0 || entry >= (int)_distributions.size()) {
+            auto listed = _listed.empty() ? _listed.end() : _listed.find(pairKey(a, b));
+            entry = listed == _listed.end() ? 0 : listed->second;
+        }
+        delay.distribution = (uint16_t)entry;
+        delay.maxDelay = (uint16_t)std::min<int>(_distributions[entry].getChannelDelay(a, b), UINT16_MAX);
         return delay;
     }
 }
@@ -0,0 +1,428 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Generative models of topologies that change every round. A model is stepped once at the start
+// of each round and only emits the edges that changed, as TopologyEvents the network applies the
+// same way as a topology trace. The work per round is proportional to the number of changes (and,
+// for geometric models, to the number of edges), never to the number of possible edges.
+//
+// A topology selects a model with a "dynamics" object, over peer ids [0, initialPeers):
+//   "edgeMarkovian"   every absent edge appears with probability "birth", every present edge
+//                     disappears with probability "death". Starts from a random graph of density
+//                     "initialDensity" (by default the stationary birth / (birth + death)).
+//   "randomWaypoint"  peers move in a "width" x "height" area towards random waypoints at a speed
+//                     in ["minSpeed", "maxSpeed"] per round, wait "pause" rounds at each one, and
+//                     are neighbors while within "radius" of each other.
+//   "rotation"        the edges of the base topology take turns, "edgesPerRound" of them at a time;
+//                     every edge is used once before any is used again.
+// Edges of the two first models are undirected. The base topology is kept underneath them.
+
+#ifndef DynamicGraph_hpp
+#define DynamicGraph_hpp
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "Distribution.hpp"
+#include "TopologyTrace.hpp"
+#include "Checkpoint.hpp"
+
+namespace quantas {
+
+    using std::vector;
+
+    // Calls visit(k) for every k in [0, count) independently with probability p, in increasing
+    // order. Gaps between hits are drawn from the geometric distribution, so the cost is one
+    // random number per hit rather than one per index.
+    template<class F>
+    void sampleBernoulli(uint64_t count, double p, F &&visit) {
+        if (p <= 0 || count == 0) {
+            return;
+        }
+        if (p >= 1) {
+            for (uint64_t k = 0; k < count; k++) {
+                visit(k);
+            }
+            return;
+        }
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        double logMiss = std::log1p(-p);
+        uint64_t k = 0;
+        while (true) {
+            double skip = std::floor(std::log(1.0 - unit(RANDOM_GENERATOR)) / logMiss);
+            if (skip >= (double)(count - k)) {
+                return;
+            }
+            k += (uint64_t)skip;
+            visit(k);
+            if (++k == count) {
+                return;
+            }
+        }
+    }
+
+    //
+    // A fixed set of edges that take turns being present, a few per round
+    //
+    class EdgeRotation {
+    public:
+        typedef std::pair<uint32_t, uint32_t>   Edge;
+
+        EdgeRotation                                        () {};
+        EdgeRotation                                        (vector<Edge> edges, size_t edgesPerRound) : _all(std::move(edges)), _edgesPerRound(edgesPerRound) {};
+
+        // picks the edges of the next round among those not used since the last refill. Picking
+        // swaps a random unused edge to the back, so a round costs O(edgesPerRound).
+        const vector<Edge>&         next                    ();
+        const vector<Edge>&         present                 ()const                     {return _present;};
+        const vector<Edge>&         edges                   ()const                     {return _all;};
+        void                        serialize               (Checkpoint &archive)       {archive & _all & _unused & _present & _edgesPerRound;};
+
+    private:
+        vector<Edge>                _all;
+        vector<Edge>                _unused;
+        vector<Edge>                _present;
+        size_t                      _edgesPerRound = 0;
+    };
+
+    inline const vector<EdgeRotation::Edge>& EdgeRotation::next() {
+        _present.clear();
+        if (_unused.empty()) {
+            _unused = _all;
+        }
+        while (_present.size() < _edgesPerRound && !_unused.empty()) {
+            std::uniform_int_distribution<size_t> pick(0, _unused.size() - 1);
+            std::swap(_unused[pick(RANDOM_GENERATOR)], _unused.back());
+            _present.push_back(_unused.back());
+            _unused.pop_back();
+        }
+        return _present;
+    }
+
+    //
+    // Base class of the models
+    //
+    class DynamicGraph {
+    public:
+        virtual ~DynamicGraph                               () {};
+
+        // builds the model selected by a topology's "dynamics", or returns nullptr if there is none
+        static std::unique_ptr<DynamicGraph> create         (json dynamics, int numberOfPeers);
+
+        // models that rearrange the base topology are given its edges and take them over
+        virtual bool                usesBaseTopology        ()const                     {return false;};
+        virtual void                setBaseTopology         (vector<EdgeRotation::Edge>) {};
+        // appends the changes taking effect at the start of round
+        virtual void                step                    (int round, vector<TopologyEvent> &changes) = 0;
+        // saves or restores the model's state for a checkpoint
+        virtual void                serialize               (Checkpoint &archive) = 0;
+
+    protected:
+        static void                 addUndirected           (vector<TopologyEvent> &changes, uint32_t op, uint32_t a, uint32_t b) {
+            changes.push_back({0, a, b, op});
+            changes.push_back({0, b, a, op});
+        };
+    };
+
+    //
+    // Edge-Markovian graph
+    //
+    class EdgeMarkovianGraph : public DynamicGraph {
+    public:
+        EdgeMarkovianGraph                                  (int numberOfPeers, double birth, double death, double initialDensity);
+
+        void                        step                    (int round, vector<TopologyEvent> &changes);
+        void                        serialize               (Checkpoint &archive);
+
+    private:
+        uint64_t                    _peers;
+        double                      _birth;
+        double                      _death;
+        double                      _initialDensity;
+        bool                        _started = false;
+        // present edges as keys a * peers + b (a < b), and where each one is in _edges
+        vector<uint64_t>            _edges;
+        std::unordered_map<uint64_t, size_t> _position;
+
+        // the index-th of the peers * (peers - 1) / 2 unordered pairs
+        uint64_t                    pairKey                 (uint64_t index)const;
+        void                        add                     (uint64_t key, vector<TopologyEvent> &changes);
+        void                        remove                  (uint64_t key, vector<TopologyEvent> &changes);
+    };
+
+    inline EdgeMarkovianGraph::EdgeMarkovianGraph(int numberOfPeers, double birth, double death, double initialDensity) {
+        _peers = numberOfPeers;
+        _birth = birth;
+        _death = death;
+        _initialDensity = initialDensity;
+    }
+
+    inline uint64_t EdgeMarkovianGraph::pairKey(uint64_t index)const {
+        // row a holds the pairs (a, a+1) ... (a, peers-1) and starts at a * peers - a * (a + 1) / 2
+        auto rowStart = [this](uint64_t a) { return a * _peers - a * (a + 1) / 2; };
+        double n = (double)_peers;
+        uint64_t a = (uint64_t)std::max(0.0, std::floor(n - 0.5 - std::sqrt((n - 0.5) * (n - 0.5) - 2.0 * index)));
+        // correct floating point error
+        while (a > 0 && rowStart(a) > index) {
+            --a;
+        }
+        while (rowStart(a + 1) <= index) {
+            ++a;
+        }
+        uint64_t b = a + 1 + (index - rowStart(a));
+        return a * _peers + b;
+    }
+
+    inline void EdgeMarkovianGraph::add(uint64_t key, vector<TopologyEvent> &changes) {
+        _position[key] = _edges.size();
+        _edges.push_back(key);
+        addUndirected(changes, TopologyEvent::ADD_EDGE, key / _peers, key % _peers);
+    }
+
+    inline void EdgeMarkovianGraph::remove(uint64_t key, vector<TopologyEvent> &changes) {
+        size_t position = _position[key];
+        _position[_edges.back()] = position;
+        _edges[position] = _edges.back();
+        _edges.pop_back();
+        _position.erase(key);
+        addUndirected(changes, TopologyEvent::REMOVE_EDGE, key / _peers, key % _peers);
+    }
+
+    inline void EdgeMarkovianGraph::serialize(Checkpoint &archive) {
+        archive & _started & _edges;
+        if (archive.restoring()) {
+            _position.clear();
+            for (size_t i = 0; i < _edges.size(); i++) {
+                _position[_edges[i]] = i;
+            }
+        }
+    }
+
+    inline void EdgeMarkovianGraph::step(int, vector<TopologyEvent> &changes) {
+        uint64_t pairs = _peers * (_peers - 1) / 2;
+        if (!_started) {
+            _started = true;
+            sampleBernoulli(pairs, _initialDensity, [&](uint64_t index) { add(pairKey(index), changes); });
+            return;
+        }
+
+        // deaths among the edges present at the start of the round
+        vector<uint64_t> died;
+        sampleBernoulli(_edges.size(), _death, [&](uint64_t index) { died.push_back(_edges[index]); });
+        for (uint64_t key : died) {
+            remove(key, changes);
+        }
+        // births among the edges absent at the start of the round
+        std::unordered_set<uint64_t> justDied(died.begin(), died.end());
+        sampleBernoulli(pairs, _birth, [&](uint64_t index) {
+            uint64_t key = pairKey(index);
+            if (_position.count(key) == 0 && justDied.count(key) == 0) {
+                add(key, changes);
+            }
+        });
+    }
+
+    //
+    // Random waypoint proximity graph
+    //
+    class RandomWaypointGraph : public DynamicGraph {
+    public:
+        RandomWaypointGraph                                 (int numberOfPeers, json parameters);
+
+        void                        step                    (int round, vector<TopologyEvent> &changes);
+        void                        serialize               (Checkpoint &archive)       {archive & _walkers & _adjacency;};
+
+    private:
+        struct Walker {
+            double  x, y;           // position
+            double  toX, toY;       // waypoint
+            double  speed;
+            int     pause;          // rounds left to wait at the waypoint
+        };
+
+        double                      _width = 1;
+        double                      _height = 1;
+        double                      _radius = 0.1;
+        double                      _minSpeed = 0.01;
+        double                      _maxSpeed = 0.01;
+        int                         _pause = 0;
+        vector<Walker>              _walkers;
+        // neighbors with a higher id, sorted
+        vector<vector<uint32_t>>    _adjacency;
+
+        void                        newWaypoint             (Walker&);
+        void                        move                    (Walker&);
+    };
+
+    inline RandomWaypointGraph::RandomWaypointGraph(int numberOfPeers, json parameters) {
+        if (parameters.contains("width")) _width = parameters["width"];
+        if (parameters.contains("height")) _height = parameters["height"];
+        if (parameters.contains("radius")) _radius = parameters["radius"];
+        if (parameters.contains("minSpeed")) _minSpeed = parameters["minSpeed"];
+        if (parameters.contains("maxSpeed")) _maxSpeed = parameters["maxSpeed"];
+        if (parameters.contains("pause")) _pause = parameters["pause"];
+        _maxSpeed = std::max(_minSpeed, _maxSpeed);
+
+        std::uniform_real_distribution<double> x(0, _width), y(0, _height);
+        _walkers.resize(numberOfPeers);
+        for (Walker &walker : _walkers) {
+            walker.x = x(RANDOM_GENERATOR);
+            walker.y = y(RANDOM_GENERATOR);
+            newWaypoint(walker);
+        }
+        _adjacency.resize(numberOfPeers);
+    }
+
+    inline void RandomWaypointGraph::newWaypoint(Walker &walker) {
+        std::uniform_real_distribution<double> x(0, _width), y(0, _height), speed(_minSpeed, _maxSpeed);
+        walker.toX = x(RANDOM_GENERATOR);
+        walker.toY = y(RANDOM_GENERATOR);
+        walker.speed = speed(RANDOM_GENERATOR);
+        walker.pause = 0;
+    }
+
+    inline void RandomWaypointGraph::move(Walker &walker) {
+        if (walker.pause > 0) {
+            if (--walker.pause == 0) {
+                newWaypoint(walker);
+            }
+            return;
+        }
+        double dx = walker.toX - walker.x;
+        double dy = walker.toY - walker.y;
+        double distance = std::hypot(dx, dy);
+        if (distance <= walker.speed) {
+            walker.x = walker.toX;
+            walker.y = walker.toY;
+            walker.pause = _pause;
+            if (_pause == 0) {
+                newWaypoint(walker);
+            }
+        }
+        else {
+            walker.x += dx / distance * walker.speed;
+            walker.y += dy / distance * walker.speed;
+        }
+    }
+
+    inline void RandomWaypointGraph::step(int round, vector<TopologyEvent> &changes) {
+        if (round > 0) {
+            for (Walker &walker : _walkers) {
+                move(walker);
+            }
+        }
+
+        // bucket the peers into cells at least radius wide, so neighbors are in adjacent cells
+        int columns = (int)std::max(1.0, std::min(std::floor(_width / _radius), 4096.0));
+        int rows = (int)std::max(1.0, std::min(std::floor(_height / _radius), 4096.0));
+        auto cellOf = [&](const Walker &walker, int &column, int &row) {
+            column = std::min(columns - 1, (int)(walker.x / _width * columns));
+            row = std::min(rows - 1, (int)(walker.y / _height * rows));
+        };
+        vector<vector<uint32_t>> cells(columns * rows);
+        for (uint32_t i = 0; i < _walkers.size(); i++) {
+            int column, row;
+            cellOf(_walkers[i], column, row);
+            cells[row * columns + column].push_back(i);
+        }
+
+        double radiusSquared = _radius * _radius;
+        vector<uint32_t> neighbors;
+        for (uint32_t i = 0; i < _walkers.size(); i++) {
+            neighbors.clear();
+            int column, row;
+            cellOf(_walkers[i], column, row);
+            for (int r = std::max(0, row - 1); r <= std::min(rows - 1, row + 1); r++) {
+                for (int c = std::max(0, column - 1); c <= std::min(columns - 1, column + 1); c++) {
+                    for (uint32_t j : cells[r * columns + c]) {
+                        double dx = _walkers[i].x - _walkers[j].x;
+                        double dy = _walkers[i].y - _walkers[j].y;
+                        if (j > i && dx * dx + dy * dy <= radiusSquared) {
+                            neighbors.push_back(j);
+                        }
+                    }
+                }
+            }
+            std::sort(neighbors.begin(), neighbors.end());
+
+            // emit the difference with last round
+            vector<uint32_t> &previous = _adjacency[i];
+            auto p = previous.begin();
+            auto n = neighbors.begin();
+            while (p != previous.end() || n != neighbors.end()) {
+                if (n == neighbors.end() || (p != previous.end() && *p < *n)) {
+                    addUndirected(changes, TopologyEvent::REMOVE_EDGE, i, *p++);
+                }
+                else if (p == previous.end() || *n < *p) {
+                    addUndirected(changes, TopologyEvent::ADD_EDGE, i, *n++);
+                }
+                else {
+                    ++p;
+                    ++n;
+                }
+            }
+            previous.assign(neighbors.begin(), neighbors.end());
+        }
+    }
+
+    //
+    // Rotation of the base topology's edges
+    //
+    class RotationGraph : public DynamicGraph {
+    public:
+        RotationGraph                                       (size_t edgesPerRound) : _edgesPerRound(edgesPerRound) {};
+
+        bool                        usesBaseTopology        ()const                     {return true;};
+        void                        setBaseTopology         (vector<EdgeRotation::Edge> edges) {_rotation = EdgeRotation(std::move(edges), _edgesPerRound);};
+        void                        step                    (int round, vector<TopologyEvent> &changes);
+        void                        serialize               (Checkpoint &archive)       {archive & _rotation;};
+
+    private:
+        size_t                      _edgesPerRound;
+        EdgeRotation                _rotation;
+    };
+
+    inline void RotationGraph::step(int, vector<TopologyEvent> &changes) {
+        for (const EdgeRotation::Edge &edge : _rotation.present()) {
+            changes.push_back({0, edge.first, edge.second, TopologyEvent::REMOVE_EDGE});
+        }
+        for (const EdgeRotation::Edge &edge : _rotation.next()) {
+            changes.push_back({0, edge.first, edge.second, TopologyEvent::ADD_EDGE});
+        }
+    }
+
+    inline std::unique_ptr<DynamicGraph> DynamicGraph::create(json dynamics, int numberOfPeers) {
+        string model = dynamics.contains("model") ? dynamics["model"] : "";
+        if (model == "edgeMarkovian") {
+            double birth = dynamics.contains("birth") ? (double)dynamics["birth"] : 0.0;
+            double death = dynamics.contains("death") ? (double)dynamics["death"] : 0.0;
+            double density = birth + death > 0 ? birth / (birth + death) : 0.0;
+            if (dynamics.contains("initialDensity")) {
+                density = dynamics["initialDensity"];
+            }
+            return std::unique_ptr<DynamicGraph>(new EdgeMarkovianGraph(numberOfPeers, birth, death, density));
+        }
+        if (model == "randomWaypoint") {
+            return std::unique_ptr<DynamicGraph>(new RandomWaypointGraph(numberOfPeers, dynamics));
+        }
+        if (model == "rotation") {
+            size_t edgesPerRound = dynamics.contains("edgesPerRound") ? (size_t)dynamics["edgesPerRound"] : 1;
+            return std::unique_ptr<DynamicGraph>(new RotationGraph(edgesPerRound));
+        }
+        std::cerr << "Error: unknown dynamics model " << model << std::endl;
+        return nullptr;
+    }
+}
+
+#endif /* DynamicGraph_hpp */
@@ -0,0 +1,210 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class gives read-only access to a topology stored as a compressed sparse row (CSR) binary
+// file. The file is memory-mapped rather than read, so opening it costs next to nothing, the pages
+// are shared with every other process mapping the same file (e.g. concurrently running
+// experiments), and a file is only mapped once per process however many tests use it.
+//
+// Layout (native endianness, every section aligned to its element size):
+//   Header      magic "QCSR", version, flags, number of nodes n, number of edges m
+//   offsets     n + 1 uint64, the edges of node i are [offsets[i], offsets[i+1])
+//   targets     m uint32, the neighbor of each edge
+//   delays      m uint16, the maximum delay of each edge's channel (only if HAS_DELAYS is set)
+//   classes     m uint16, the entry of the DelayTable each edge's channel uses (only if HAS_CLASSES is set)
+//
+// Files are produced offline from a text edge list by Tools/EdgeListToCSR.cpp.
+
+#ifndef EdgeFile_hpp
+#define EdgeFile_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include "MappedFile.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+
+    class EdgeFile {
+    public:
+        static const uint32_t   MAGIC      = 0x52534351; // "QCSR"
+        static const uint32_t   VERSION    = 1;
+        static const uint32_t   HAS_DELAYS = 1;
+        static const uint32_t   HAS_CLASSES = 2;
+
+        struct Header {
+            uint32_t    magic;
+            uint32_t    version;
+            uint32_t    flags;
+            uint32_t    reserved;
+            uint64_t    nodes;
+            uint64_t    edges;
+        };
+
+        // maps path, or returns the mapping already made for it
+        static std::shared_ptr<const EdgeFile> open(const string &path);
+        // writes a CSR file, delays and classes may be empty
+        static void             write       (const string &path, const vector<uint64_t> &offsets, const vector<uint32_t> &targets, const vector<uint16_t> &delays, const vector<uint16_t> &classes = {});
+
+        uint64_t                nodes       ()const                 {return _header->nodes;};
+        uint64_t                edges       ()const                 {return _header->edges;};
+        bool                    hasDelays   ()const                 {return _delays != nullptr;};
+        bool                    hasClasses  ()const                 {return _classes != nullptr;};
+        uint64_t                degree      (uint64_t node)const    {return _offsets[node + 1] - _offsets[node];};
+        const uint32_t*         begin       (uint64_t node)const    {return _targets + _offsets[node];};
+        const uint32_t*         end         (uint64_t node)const    {return _targets + _offsets[node + 1];};
+        // delay of the edge from node to target, or 0 if the file has none for it
+        int                     delay       (uint64_t node, uint32_t target)const;
+        // delay class of the edge from node to target, or 0 if the file has none for it
+        int                     channelClass(uint64_t node, uint32_t target)const;
+
+    private:
+        EdgeFile                            (const string &path);
+        // position of the edge from node to target, or -1 if there is none
+        int64_t                 find        (uint64_t node, uint32_t target)const;
+
+        MappedFile              _file;
+        const Header            *_header = nullptr;
+        const uint64_t          *_offsets = nullptr;
+        const uint32_t          *_targets = nullptr;
+        const uint16_t          *_delays = nullptr;
+        const uint16_t          *_classes = nullptr;
+    };
+
+    inline size_t edgeFileAlign(size_t offset, size_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    inline std::shared_ptr<const EdgeFile> EdgeFile::open(const string &path) {
+        static std::mutex                                         cacheMutex;
+        static std::map<string, std::shared_ptr<const EdgeFile>>  cache;
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(path);
+        if (it == cache.end()) {
+            it = cache.emplace(path, std::shared_ptr<const EdgeFile>(new EdgeFile(path))).first;
+        }
+        return it->second;
+    }
+
+    inline EdgeFile::EdgeFile(const string &path) : _file(path) {
+        if (_file.size() < sizeof(Header)) {
+            throw std::runtime_error("edge file " + path + " is truncated");
+        }
+        // neighbor lists are read front to back by each peer
+        _file.advise(MADV_WILLNEED);
+
+        const char *base = _file.data();
+        _header = reinterpret_cast<const Header*>(base);
+        if (_header->magic != MAGIC || _header->version != VERSION) {
+            throw std::runtime_error(path + " is not a QUANTAS edge file");
+        }
+        // counts no file could hold would overflow the sizes below
+        if (_header->nodes >= _file.size() / sizeof(uint64_t) || _header->edges > _file.size() / sizeof(uint32_t)) {
+            throw std::runtime_error("edge file " + path + " is truncated");
+        }
+        size_t offsetsAt = sizeof(Header);
+        size_t targetsAt = offsetsAt + (_header->nodes + 1) * sizeof(uint64_t);
+        size_t delaysAt = edgeFileAlign(targetsAt + _header->edges * sizeof(uint32_t), sizeof(uint16_t));
+        size_t classesAt = (_header->flags & HAS_DELAYS) ? delaysAt + _header->edges * sizeof(uint16_t) : delaysAt;
+        size_t expected = (_header->flags & HAS_CLASSES) ? classesAt + _header->edges * sizeof(uint16_t) : classesAt;
+        if (_file.size() < expected) {
+            throw std::runtime_error("edge file " + path + " is truncated");
+        }
+        _offsets = reinterpret_cast<const uint64_t*>(base + offsetsAt);
+        _targets = reinterpret_cast<const uint32_t*>(base + targetsAt);
+        if (_header->flags & HAS_DELAYS) {
+            _delays = reinterpret_cast<const uint16_t*>(base + delaysAt);
+        }
+        if (_header->flags & HAS_CLASSES) {
+            _classes = reinterpret_cast<const uint16_t*>(base + classesAt);
+        }
+
+        // the rows and targets are used as indices without further checks, and find bisects the
+        // rows, so a damaged file is refused here, at the cost of reading it once
+        for (uint64_t node = 0; node < _header->nodes; node++) {
+            if (_offsets[node] > _offsets[node + 1]) {
+                throw std::runtime_error("edge file " + path + " has decreasing offsets at node " + std::to_string(node));
+            }
+        }
+        if (_offsets[_header->nodes] > _header->edges) {
+            throw std::runtime_error("edge file " + path + " has offsets past its " + std::to_string(_header->edges) + " edges");
+        }
+        uint64_t row = 0;
+        for (uint64_t edge = 0; edge < _header->edges; edge++) {
+            if (_targets[edge] >= _header->nodes) {
+                throw std::runtime_error("edge file " + path + " has edge " + std::to_string(edge) + " to node " + std::to_string(_targets[edge]) + " of " + std::to_string(_header->nodes));
+            }
+            while (row < _header->nodes && _offsets[row + 1] <= edge) {
+                row++;
+            }
+            if (row < _header->nodes && edge > _offsets[row] && _targets[edge] < _targets[edge - 1]) {
+                throw std::runtime_error("edge file " + path + " has the edges of node " + std::to_string(row) + " out of order");
+            }
+        }
+    }
+
+    inline int64_t EdgeFile::find(uint64_t node, uint32_t target)const {
+        if (node >= nodes()) {
+            return -1;
+        }
+        // the converter sorts every row, so the edge can be found by bisection
+        const uint32_t *edge = std::lower_bound(begin(node), end(node), target);
+        if (edge == end(node) || *edge != target) {
+            return -1;
+        }
+        return edge - _targets;
+    }
+
+    inline int EdgeFile::delay(uint64_t node, uint32_t target)const {
+        int64_t edge = _delays == nullptr ? -1 : find(node, target);
+        return edge < 0 ? 0 : _delays[edge];
+    }
+
+    inline int EdgeFile::channelClass(uint64_t node, uint32_t target)const {
+        int64_t edge = _classes == nullptr ? -1 : find(node, target);
+        return edge < 0 ? 0 : _classes[edge];
+    }
+
+    inline void EdgeFile::write(const string &path, const vector<uint64_t> &offsets, const vector<uint32_t> &targets, const vector<uint16_t> &delays, const vector<uint16_t> &classes) {
+        std::ofstream out(path, std::ios::binary);
+        if (out.fail()) {
+            throw std::runtime_error("cannot create edge file " + path);
+        }
+        Header header;
+        std::memset(&header, 0, sizeof(Header));
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.flags = (delays.empty() ? 0 : HAS_DELAYS) | (classes.empty() ? 0 : HAS_CLASSES);
+        header.nodes = offsets.size() - 1;
+        header.edges = targets.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(targets.data()), targets.size() * sizeof(uint32_t));
+        size_t written = sizeof(Header) + offsets.size() * sizeof(uint64_t) + targets.size() * sizeof(uint32_t);
+        size_t padding = edgeFileAlign(written, sizeof(uint16_t)) - written;
+        out.write("\0", padding);
+        out.write(reinterpret_cast<const char*>(delays.data()), delays.size() * sizeof(uint16_t));
+        out.write(reinterpret_cast<const char*>(classes.data()), classes.size() * sizeof(uint16_t));
+        if (out.fail()) {
+            throw std::runtime_error("cannot write edge file " + path);
+        }
+    }
+}
+
+#endif /* EdgeFile_hpp */
@@ -0,0 +1,34 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Helpers for the names of the files an experiment writes besides its log.
+
+#ifndef FileName_hpp
+#define FileName_hpp
+
+#include <string>
+
+namespace quantas {
+
+    using std::string;
+
+    // file with suffix added to its name, before its extension if it has one, e.g. the variant
+    // number of a branch: "out/costs.csv" and ".2" give "out/costs.2.csv"
+    inline string withSuffix(string file, const string &suffix) {
+        size_t dot = file.find_last_of('.');
+        size_t slash = file.find_last_of('/');
+        if (dot == string::npos || (slash != string::npos && dot < slash)) {
+            dot = file.size();
+        }
+        file.insert(dot, suffix);
+        return file;
+    }
+}
+
+#endif /* FileName_hpp */
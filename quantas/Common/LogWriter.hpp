@@ -12,7 +12,10 @@ You should have received a copy of the GNU General Public License along with QUA
 
 #include <string>
 #include <iostream>
+#include <memory>
 #include "../Common/Json.hpp"
+#include "MetricsWriter.hpp"
+#include "FileName.hpp"
 
 namespace quantas {
 
@@ -20,12 +23,16 @@ namespace quantas {
     using std::ostream;
     using std::cout;
     using std::endl;
+    using std::string;
 
     class LogWriter {
     protected:
         ostream* _log = &cout;
         int         _round = 0;
         int         _test = 0;
+        // where recorded values are streamed to, if anywhere
+        std::unique_ptr<MetricsWriter> _metrics;
+        json        _metricsConfig;
 
     public:
         static LogWriter*  instance () {
@@ -47,12 +54,53 @@ namespace quantas {
         void                setRound        (int round)     { _round = round; }
         int                 getRound        ()const         { return _round; }
 
+        // adds value to this test's series of metric, in the metrics file when one is open
+        template<class T>
+        void                record          (const string &metric, T value) {
+            if (_metrics) {
+                _metrics->write(_test, _round, metric, static_cast<double>(value));
+            }
+            else {
+                data["tests"][_test][metric].push_back(value);
+            }
+        }
+        // streams recorded values to the file metrics names ({"file", "format", "batchSize",
+        // "queuedBatches"}), with suffix added before its extension, until closeMetrics
+        void                openMetrics     (json metrics, const string &suffix = "");
+        // waits until everything recorded is in the file
+        void                flushMetrics    ()              { if (_metrics) _metrics->flush(); }
+        void                closeMetrics    ()              { _metrics.reset(); }
+        // opens the metrics file again with suffix, in a forked child, where the writing thread
+        // of the parent's file does not exist
+        void                reopenMetrics   (const string &suffix);
+
     private:
         // copying and creation prohibited by clients
         LogWriter(){}
         LogWriter(const LogWriter&){}
     };
 
+    inline void LogWriter::openMetrics(json metrics, const string &suffix) {
+        _metricsConfig = metrics;
+        string file = withSuffix(metrics.value("file", string()), suffix);
+        MetricsWriter::Format format;
+        if (!MetricsWriter::formatOf(metrics.value("format", file), format)) {
+            std::cerr << "Error: unknown metrics format for " << file << ", use csv, ndjson or binary" << std::endl;
+            return;
+        }
+        _metrics.reset(new MetricsWriter(file, format, metrics.value("batchSize", 4096), metrics.value("queuedBatches", 4)));
+        if (!_metrics->good()) {
+            _metrics.reset();
+        }
+    }
+
+    inline void LogWriter::reopenMetrics(const string &suffix) {
+        if (_metrics) {
+            _metrics.release();
+            openMetrics(_metricsConfig, suffix);
+        }
+    }
+
 }
 
 #endif // LogWriter_hpp
@@ -0,0 +1,83 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class maps a whole file read-only into memory. The mapping is shared, so processes mapping
+// the same file use the same pages of the page cache. It is the storage behind the binary input
+// formats (EdgeFile, TopologyTrace), which read their contents in place.
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <string>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace quantas {
+
+    using std::string;
+
+    class MappedFile {
+    public:
+        // throws std::runtime_error if the file cannot be opened or mapped
+        explicit MappedFile                 (const string &path);
+        ~MappedFile                         ();
+        MappedFile                          (const MappedFile&) = delete;
+        MappedFile&             operator=   (const MappedFile&) = delete;
+
+        const char*             data        ()const                 {return static_cast<const char*>(_map);};
+        size_t                  size        ()const                 {return _length;};
+        // hint how the file will be read (MADV_SEQUENTIAL, MADV_WILLNEED, ...)
+        void                    advise      (int advice)const       {if (_length > 0) madvise(_map, _length, advice);};
+        // drops the pages wholly inside [0, end) from this process, they are read back from the page cache if touched again
+        void                    release     (size_t end)const;
+
+    private:
+        void                    *_map = MAP_FAILED;
+        size_t                  _length = 0;
+    };
+
+    inline MappedFile::MappedFile(const string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot read " + path);
+        }
+        _length = info.st_size;
+        if (_length > 0) {
+            _map = mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (_length > 0 && _map == MAP_FAILED) {
+            throw std::runtime_error("cannot map " + path);
+        }
+    }
+
+    inline MappedFile::~MappedFile() {
+        if (_map != MAP_FAILED) {
+            munmap(_map, _length);
+        }
+    }
+
+    inline void MappedFile::release(size_t end)const {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t length = end / page * page;
+        if (_map != MAP_FAILED && length > 0) {
+            madvise(_map, length, MADV_DONTNEED);
+        }
+    }
+}
+
+#endif /* MappedFile_hpp */
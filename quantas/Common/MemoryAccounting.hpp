@@ -0,0 +1,259 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class accounts the memory the simulation holds, when an experiment asks for it with
+//
+//     "memory": {"budget": "2GB", "action": "warn", "top": 10}
+//
+// Every round, the bytes of the packets in flight to each peer (and of its channels) are added up
+// once it has received, when it alone touches its inbound channels, and those of the packets in
+// its in and out streams and of its state, as its stateBytes() estimates it, just before it
+// transmits. The totals are recorded as the series memory.bytes, memory.channels, memory.streams
+// and memory.state. At the end of each test its log gets "memory": the round the total peaked at
+// with its parts, the "top" peers by the most each held in a round, and the peak resident memory
+// of the process.
+//
+// Packets are counted by their size, so what a message holds on the heap (strings, vectors) is
+// only counted where the peer's stateBytes() does. When the total goes over the budget, in bytes
+// or with a KB, MB or GB suffix, a warning is printed once per test, or with "action": "abort" the
+// run stops there and its log is written as it is.
+
+#ifndef MemoryAccounting_hpp
+#define MemoryAccounting_hpp
+
+#include <cstdint>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <sys/resource.h>
+#include "Json.hpp"
+#include "LogWriter.hpp"
+#include "Checkpoint.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class MemoryAccounting {
+    public:
+        enum Part { CHANNELS, STREAMS, STATE, PARTS };
+        // what the peers a thread accounted for held
+        struct Totals {
+            uint64_t            bytes[PARTS] = {};
+        };
+
+        // memory is the experiment's "memory", accounting is off without it
+        void                    configure       (const json &memory);
+        bool                    enabled         ()const                 {return _enabled;};
+        // clears the accounts, for a test of peers peers
+        void                    reset           (size_t peers);
+
+        // called after peer i receives, adding what its inbound channels hold to held
+        template<class P>
+        void                    accountChannels (size_t i, const P &peer, Totals &held);
+        // called before peer i transmits, adding what its streams and state hold to held
+        template<class P>
+        void                    accountStreams  (size_t i, const P &peer, Totals &held);
+        // called once per block and phase with what its peers held
+        void                    add             (const Totals &held);
+        // called once the round's peers are accounted for, false if the run is to stop
+        bool                    endRound        (int test, int round);
+
+        // the accounts of the test, ids being the peers' ids
+        json                    report          (const vector<long> &ids)const;
+        // saves or restores the accounts of the test so far, between two rounds
+        void                    serialize       (Checkpoint &archive);
+
+        // bytes given as a number or with a KB, MB or GB suffix
+        static uint64_t         parseBytes      (const json &bytes);
+
+    private:
+        bool                    _enabled = false;
+        uint64_t                _budget = 0;
+        bool                    _abort = false;
+        size_t                  _top = 10;
+        std::atomic<uint64_t>   _round[PARTS];
+        vector<uint64_t>        _max;
+        vector<uint64_t>        _channels;      // what each peer's channels held this round
+        uint64_t                _peak = 0;
+        uint64_t                _peakParts[PARTS] = {};
+        int                     _peakRound = -1;
+        int                     _exceededRound = -1;
+        uint64_t                _exceededBytes = 0;
+
+        static const char*      name            (Part part);
+    };
+
+    inline const char* MemoryAccounting::name(Part part) {
+        static const char* names[PARTS] = {"channels", "streams", "state"};
+        return names[part];
+    }
+
+    inline uint64_t MemoryAccounting::parseBytes(const json &bytes) {
+        if (bytes.is_number()) {
+            return bytes.get<uint64_t>();
+        }
+        if (!bytes.is_string()) {
+            return 0;
+        }
+        string text = bytes;
+        size_t end = 0;
+        double value = std::stod(text, &end);
+        string unit = text.substr(end);
+        unit.erase(std::remove_if(unit.begin(), unit.end(), ::isspace), unit.end());
+        std::transform(unit.begin(), unit.end(), unit.begin(), ::toupper);
+        if (unit == "KB" || unit == "K") {
+            value *= 1024;
+        }
+        else if (unit == "MB" || unit == "M") {
+            value *= 1024 * 1024;
+        }
+        else if (unit == "GB" || unit == "G") {
+            value *= 1024.0 * 1024 * 1024;
+        }
+        else if (!unit.empty() && unit != "B") {
+            std::cerr << "Error: unknown unit in memory budget " << text << std::endl;
+        }
+        return static_cast<uint64_t>(value);
+    }
+
+    inline void MemoryAccounting::configure(const json &memory) {
+        _enabled = memory.is_object() || (memory.is_boolean() && memory.get<bool>());
+        if (!memory.is_object()) {
+            return;
+        }
+        try {
+            _budget = memory.contains("budget") ? parseBytes(memory["budget"]) : 0;
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Error: cannot read memory budget " << memory["budget"] << std::endl;
+        }
+        _abort = memory.value("action", string("warn")) == "abort";
+        _top = memory.value("top", 10);
+    }
+
+    inline void MemoryAccounting::reset(size_t peers) {
+        if (!_enabled) {
+            return;
+        }
+        _max.assign(peers, 0);
+        _channels.assign(peers, 0);
+        for (int p = 0; p < PARTS; p++) {
+            _round[p].store(0);
+            _peakParts[p] = 0;
+        }
+        _peak = 0;
+        _peakRound = -1;
+        _exceededRound = -1;
+        _exceededBytes = 0;
+    }
+
+    template<class P>
+    void MemoryAccounting::accountChannels(size_t i, const P &peer, Totals &held) {
+        _channels[i] = peer.channelBytes();
+        held.bytes[CHANNELS] += _channels[i];
+    }
+
+    template<class P>
+    void MemoryAccounting::accountStreams(size_t i, const P &peer, Totals &held) {
+        uint64_t streams = peer.streamBytes();
+        uint64_t state = peer.stateBytes();
+        held.bytes[STREAMS] += streams;
+        held.bytes[STATE] += state;
+        _max[i] = std::max<uint64_t>(_max[i], _channels[i] + streams + state);
+    }
+
+    inline void MemoryAccounting::add(const Totals &held) {
+        for (int p = 0; p < PARTS; p++) {
+            _round[p].fetch_add(held.bytes[p], std::memory_order_relaxed);
+        }
+    }
+
+    inline bool MemoryAccounting::endRound(int test, int round) {
+        if (!_enabled) {
+            return true;
+        }
+        uint64_t parts[PARTS];
+        uint64_t total = 0;
+        for (int p = 0; p < PARTS; p++) {
+            parts[p] = _round[p].exchange(0);
+            total += parts[p];
+            LogWriter::instance()->record(string("memory.") + name(Part(p)), double(parts[p]));
+        }
+        LogWriter::instance()->record("memory.bytes", double(total));
+        if (total > _peak || _peakRound < 0) {
+            _peak = total;
+            _peakRound = round;
+            std::copy(parts, parts + PARTS, _peakParts);
+        }
+        if (_budget == 0 || total <= _budget || _exceededRound >= 0) {
+            return true;
+        }
+        _exceededRound = round;
+        _exceededBytes = total;
+        if (_abort) {
+            std::cerr << "Error: memory budget of " << _budget << " bytes exceeded in test " << test << " round " << round << " (" << total << " bytes), stopping the run" << std::endl;
+            return false;
+        }
+        std::cerr << "Warning: memory budget of " << _budget << " bytes exceeded in test " << test << " round " << round << " (" << total << " bytes)" << std::endl;
+        return true;
+    }
+
+    inline void MemoryAccounting::serialize(Checkpoint &archive) {
+        bool enabled = _enabled;
+        archive & enabled;
+        if (enabled != _enabled) {
+            archive.fail("the checkpoint was taken with other \"memory\" settings");
+            return;
+        }
+        archive & _max & _peak & _peakParts & _peakRound & _exceededRound & _exceededBytes;
+    }
+
+    inline json MemoryAccounting::report(const vector<long> &ids)const {
+        json memory;
+        if (!_enabled) {
+            return memory;
+        }
+        memory["peakBytes"] = _peak;
+        memory["peakRound"] = _peakRound;
+        for (int p = 0; p < PARTS; p++) {
+            memory["peak"][name(Part(p))] = _peakParts[p];
+        }
+        // the peers that held the most, most first and by id among equals
+        vector<size_t> order(_max.size());
+        std::iota(order.begin(), order.end(), 0);
+        size_t count = std::min(_top, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](size_t a, size_t b) {
+            return _max[a] != _max[b] ? _max[a] > _max[b] : ids[a] < ids[b];
+        });
+        memory["top"] = json::array();
+        for (size_t k = 0; k < count; k++) {
+            memory["top"].push_back({{"peer", ids[order[k]]}, {"bytes", _max[order[k]]}});
+        }
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            memory["peakRssKB"] = usage.ru_maxrss;
+        }
+        if (_budget > 0) {
+            memory["budget"] = _budget;
+        }
+        if (_exceededRound >= 0) {
+            memory["budgetExceeded"] = {{"round", _exceededRound}, {"bytes", _exceededBytes}};
+        }
+        return memory;
+    }
+}
+
+#endif /* MemoryAccounting_hpp */
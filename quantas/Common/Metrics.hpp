@@ -0,0 +1,609 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class is the registry of the metrics an algorithm measures. A metric is registered once by
+// name, usually as a static member of the peer class, and updated through the handle returned:
+//
+//     Counter   KademliaPeer::totalHops = Metrics::instance().counter("totalHops", false);
+//     ...
+//     totalHops += message.hops;
+//
+// Counters and histograms are updated by the peers from the threads of the round, each thread
+// into a shard of its own, so an update costs an add and never waits for another thread. Their
+// value is the sum of the shards, read between the phases of a round. Gauges hold one value,
+// typically set in endOfRound.
+//
+// Every "interval" rounds (and at the last round) the registry samples its metrics into the
+// log with LogWriter::record: logged counters by their total, gauges that were set since the
+// last sample by their value and logged histograms as name.count, .mean, .p50, .p90, .p99 and
+// .max. Histograms keep values to about 3% in log-linear buckets, and their count, sum and
+// maximum exactly. All values are cleared at the start of each test.
+//
+// A default constructed handle, or the one returned once MAX_COUNTERS or MAX_HISTOGRAMS are
+// registered, belongs to no metric: its updates are dropped and it reads 0.
+
+#ifndef Metrics_hpp
+#define Metrics_hpp
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <iostream>
+#include "LogWriter.hpp"
+#include "Checkpoint.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+
+    class Metrics;
+
+    // handles to registered metrics, cheap to copy and safe to use from any thread
+    class Counter {
+    public:
+        Counter                                 ()                      : _id(-1) {};
+        void                    add             (int64_t amount = 1)const;
+        void                    operator+=      (int64_t amount)const   {add(amount);};
+        void                    operator++      (int)const              {add(1);};
+        // the total of this test so far, read between phases
+        int64_t                 value           ()const;
+    private:
+        friend class Metrics;
+        explicit Counter                        (int id)                : _id(id) {};
+        int                     _id;
+    };
+
+    class Gauge {
+    public:
+        Gauge                                   ()                      : _id(-1) {};
+        void                    set             (double value)const;
+        double                  value           ()const;
+    private:
+        friend class Metrics;
+        explicit Gauge                          (int id)                : _id(id) {};
+        int                     _id;
+    };
+
+    class Histogram {
+    public:
+        Histogram                               ()                      : _id(-1) {};
+        // adds a value, negative values count as 0
+        void                    record          (int64_t value)const;
+        uint64_t                count           ()const;
+        double                  mean            ()const;
+        // the value below which fraction of the recorded values lie, to within a bucket
+        int64_t                 percentile      (double fraction)const;
+        int64_t                 max             ()const;
+    private:
+        friend class Metrics;
+        explicit Histogram                      (int id)                : _id(id) {};
+        int                     _id;
+    };
+
+    class Metrics {
+    public:
+        static const int        MAX_COUNTERS    = 256;
+        static const int        MAX_HISTOGRAMS  = 64;
+        // values below 2^SUB_BITS have a bucket each, larger ones 2^SUB_BITS buckets per power of two
+        static const int        SUB_BITS        = 5;
+        static const int        SUB             = 1 << SUB_BITS;
+        static const int        BUCKETS         = SUB + (64 - SUB_BITS) * SUB;
+
+        static Metrics&         instance        () {
+            static Metrics s;
+            return s;
+        }
+
+        // returns the metric registered as name, registering it if it is new. Counters and
+        // histograms that are not logged are only read by the algorithm
+        Counter                 counter         (const string &name, bool logged = true);
+        Gauge                   gauge           (const string &name);
+        Histogram               histogram       (const string &name, bool logged = true);
+        // logs, or stops logging, the counters and histograms registered with names starting
+        // with prefix, e.g. those of a measurement the next experiment of the process turns off
+        void                    setLogged       (const string &prefix, bool logged);
+
+        // log every interval rounds
+        void                    setInterval     (int interval)          {_interval = interval > 0 ? interval : 1;};
+        // clears every value, at the start of a test
+        void                    reset           ();
+        // called at the end of every round, logs the metrics if it is a sampled round
+        void                    sample          (bool lastRound);
+        // the totals, for checkpoints
+        void                    serialize       (Checkpoint &archive);
+
+        static int              bucket          (uint64_t value);
+        // the smallest value in bucket and the number of values it holds
+        static uint64_t         bucketLow       (int bucket);
+        static uint64_t         bucketWidth     (int bucket);
+
+    private:
+        friend class Counter;
+        friend class Gauge;
+        friend class Histogram;
+
+        // the part of a histogram one thread writes
+        struct HistogramShard {
+            std::atomic<uint64_t>   buckets[BUCKETS];
+            std::atomic<uint64_t>   count;
+            std::atomic<int64_t>    sum;
+            std::atomic<int64_t>    max;
+            HistogramShard          ()                                  {clear();};
+            void                    clear           ();
+        };
+        // the part of every counter and histogram one thread writes
+        struct Shard {
+            std::atomic<int64_t>    counters[MAX_COUNTERS];
+            std::atomic<HistogramShard*> histograms[MAX_HISTOGRAMS];
+            Shard                   ();
+            ~Shard                  ();
+            void                    clear           ();
+            HistogramShard&         histogram       (int id);
+        };
+        // gives a thread's shard back when the thread ends
+        struct ShardHolder {
+            Shard                   *shard = nullptr;
+            ~ShardHolder            ();
+        };
+        struct GaugeValue {
+            std::atomic<double>     value;
+            std::atomic<bool>       set;
+        };
+
+        std::mutex                  _mutex;
+        std::map<string, int>       _counterIds;
+        std::map<string, int>       _gaugeIds;
+        std::map<string, int>       _histogramIds;
+        vector<string>              _counterNames;
+        vector<bool>                _counterLogged;
+        vector<string>              _histogramNames;
+        vector<bool>                _histogramLogged;
+        std::list<GaugeValue>       _gauges;
+        vector<GaugeValue*>         _gaugeValues;
+        vector<string>              _gaugeNames;
+        // shards of running threads, those of ended threads wait in _free for a new thread
+        vector<std::unique_ptr<Shard>> _shards;
+        vector<Shard*>              _free;
+        int                         _interval = 1;
+        int                         _rounds = 0;
+
+        Metrics                                 ()                      {};
+        Metrics                                 (const Metrics&) = delete;
+
+        // the calling thread's shard
+        static Shard&           local           ();
+        Shard*                  acquire         ();
+        void                    release         (Shard *shard);
+
+        int64_t                 counterValue    (int id);
+        // the shards of a histogram summed into one
+        void                    histogramTotal  (int id, HistogramShard &total);
+        static int64_t          percentileOf    (const HistogramShard &total, double fraction);
+        static double           meanOf          (const HistogramShard &total)       {return total.count ? double(total.sum) / total.count : 0;};
+    };
+
+    // the shard's values are only written by its own thread, so a load and a store are enough;
+    // they are atomic so the sums may be read from another thread
+    inline void Counter::add(int64_t amount)const {
+        if (_id < 0) {
+            return;
+        }
+        std::atomic<int64_t> &slot = Metrics::local().counters[_id];
+        slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    inline int64_t Counter::value()const {
+        if (_id < 0) {
+            return 0;
+        }
+        return Metrics::instance().counterValue(_id);
+    }
+
+    inline void Gauge::set(double value)const {
+        if (_id < 0) {
+            return;
+        }
+        Metrics::instance()._gaugeValues[_id]->value.store(value, std::memory_order_relaxed);
+        Metrics::instance()._gaugeValues[_id]->set.store(true, std::memory_order_relaxed);
+    }
+
+    inline double Gauge::value()const {
+        if (_id < 0) {
+            return 0;
+        }
+        return Metrics::instance()._gaugeValues[_id]->value.load(std::memory_order_relaxed);
+    }
+
+    inline void Histogram::record(int64_t value)const {
+        if (_id < 0) {
+            return;
+        }
+        Metrics::HistogramShard &shard = Metrics::local().histogram(_id);
+        uint64_t positive = value > 0 ? value : 0;
+        std::atomic<uint64_t> &slot = shard.buckets[Metrics::bucket(positive)];
+        slot.store(slot.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        shard.count.store(shard.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        shard.sum.store(shard.sum.load(std::memory_order_relaxed) + positive, std::memory_order_relaxed);
+        if (int64_t(positive) > shard.max.load(std::memory_order_relaxed)) {
+            shard.max.store(positive, std::memory_order_relaxed);
+        }
+    }
+
+    inline uint64_t Histogram::count()const {
+        Metrics::HistogramShard total;
+        Metrics::instance().histogramTotal(_id, total);
+        return total.count;
+    }
+
+    inline double Histogram::mean()const {
+        Metrics::HistogramShard total;
+        Metrics::instance().histogramTotal(_id, total);
+        return Metrics::meanOf(total);
+    }
+
+    inline int64_t Histogram::percentile(double fraction)const {
+        Metrics::HistogramShard total;
+        Metrics::instance().histogramTotal(_id, total);
+        return Metrics::percentileOf(total, fraction);
+    }
+
+    inline int64_t Histogram::max()const {
+        Metrics::HistogramShard total;
+        Metrics::instance().histogramTotal(_id, total);
+        return total.max;
+    }
+
+    inline void Metrics::HistogramShard::clear() {
+        for (auto &slot : buckets) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    inline Metrics::Shard::Shard() {
+        for (auto &slot : counters) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+        for (auto &slot : histograms) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    inline Metrics::Shard::~Shard() {
+        for (auto &slot : histograms) {
+            delete slot.load();
+        }
+    }
+
+    inline void Metrics::Shard::clear() {
+        for (auto &slot : counters) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+        for (auto &slot : histograms) {
+            if (HistogramShard *histogram = slot.load(std::memory_order_relaxed)) {
+                histogram->clear();
+            }
+        }
+    }
+
+    // allocated the first time the thread records into the histogram
+    inline Metrics::HistogramShard& Metrics::Shard::histogram(int id) {
+        HistogramShard *histogram = histograms[id].load(std::memory_order_acquire);
+        if (histogram == nullptr) {
+            histogram = new HistogramShard();
+            histograms[id].store(histogram, std::memory_order_release);
+        }
+        return *histogram;
+    }
+
+    inline Metrics::ShardHolder::~ShardHolder() {
+        if (shard != nullptr) {
+            Metrics::instance().release(shard);
+        }
+    }
+
+    inline Metrics::Shard& Metrics::local() {
+        thread_local ShardHolder holder;
+        if (holder.shard == nullptr) {
+            holder.shard = instance().acquire();
+        }
+        return *holder.shard;
+    }
+
+    inline Metrics::Shard* Metrics::acquire() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_free.empty()) {
+            Shard *shard = _free.back();
+            _free.pop_back();
+            return shard;
+        }
+        _shards.emplace_back(new Shard());
+        return _shards.back().get();
+    }
+
+    // an ended thread's values still count, so its shard is kept, and reused by the next thread
+    // that starts, which adds to them
+    inline void Metrics::release(Shard *shard) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(shard);
+    }
+
+    inline Counter Metrics::counter(const string &name, bool logged) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto known = _counterIds.find(name);
+        if (known != _counterIds.end()) {
+            return Counter(known->second);
+        }
+        if (_counterNames.size() == MAX_COUNTERS) {
+            std::cerr << "Error: cannot register counter " << name << ", there are already " << MAX_COUNTERS << std::endl;
+            return Counter();
+        }
+        int id = _counterNames.size();
+        _counterIds[name] = id;
+        _counterNames.push_back(name);
+        _counterLogged.push_back(logged);
+        return Counter(id);
+    }
+
+    inline Gauge Metrics::gauge(const string &name) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto known = _gaugeIds.find(name);
+        if (known != _gaugeIds.end()) {
+            return Gauge(known->second);
+        }
+        int id = _gaugeNames.size();
+        _gaugeIds[name] = id;
+        _gaugeNames.push_back(name);
+        // a list, so the values do not move when more are added
+        _gauges.emplace_back();
+        _gauges.back().value.store(0);
+        _gauges.back().set.store(false);
+        _gaugeValues.push_back(&_gauges.back());
+        return Gauge(id);
+    }
+
+    inline Histogram Metrics::histogram(const string &name, bool logged) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto known = _histogramIds.find(name);
+        if (known != _histogramIds.end()) {
+            return Histogram(known->second);
+        }
+        if (_histogramNames.size() == MAX_HISTOGRAMS) {
+            std::cerr << "Error: cannot register histogram " << name << ", there are already " << MAX_HISTOGRAMS << std::endl;
+            return Histogram();
+        }
+        int id = _histogramNames.size();
+        _histogramIds[name] = id;
+        _histogramNames.push_back(name);
+        _histogramLogged.push_back(logged);
+        return Histogram(id);
+    }
+
+    inline void Metrics::setLogged(const string &prefix, bool logged) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t id = 0; id < _counterNames.size(); id++) {
+            if (_counterNames[id].compare(0, prefix.size(), prefix) == 0) {
+                _counterLogged[id] = logged;
+            }
+        }
+        for (size_t id = 0; id < _histogramNames.size(); id++) {
+            if (_histogramNames[id].compare(0, prefix.size(), prefix) == 0) {
+                _histogramLogged[id] = logged;
+            }
+        }
+    }
+
+    inline void Metrics::reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &shard : _shards) {
+            shard->clear();
+        }
+        for (GaugeValue &gauge : _gauges) {
+            gauge.value.store(0);
+            gauge.set.store(false);
+        }
+        _rounds = 0;
+    }
+
+    inline int64_t Metrics::counterValue(int id) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        int64_t total = 0;
+        for (auto &shard : _shards) {
+            total += shard->counters[id].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    inline void Metrics::histogramTotal(int id, HistogramShard &total) {
+        if (id < 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &shard : _shards) {
+            HistogramShard *part = shard->histograms[id].load(std::memory_order_acquire);
+            if (part == nullptr) {
+                continue;
+            }
+            for (int b = 0; b < BUCKETS; b++) {
+                total.buckets[b].store(total.buckets[b].load(std::memory_order_relaxed) + part->buckets[b].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            total.count.store(total.count.load() + part->count.load(std::memory_order_relaxed));
+            total.sum.store(total.sum.load() + part->sum.load(std::memory_order_relaxed));
+            total.max.store(std::max(total.max.load(), part->max.load(std::memory_order_relaxed)));
+        }
+    }
+
+    inline int64_t Metrics::percentileOf(const HistogramShard &total, double fraction) {
+        uint64_t count = total.count.load();
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * count));
+        rank = rank < 1 ? 1 : rank;
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            seen += total.buckets[b].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                // the middle of the bucket, but never above the largest value recorded
+                int64_t value = bucketLow(b) + (bucketWidth(b) - 1) / 2;
+                return std::min(value, total.max.load());
+            }
+        }
+        return total.max.load();
+    }
+
+    inline int Metrics::bucket(uint64_t value) {
+        if (value < SUB) {
+            return static_cast<int>(value);
+        }
+        int top = 63;
+        while ((value >> top) == 0) {
+            top--;
+        }
+        int shift = top - SUB_BITS;
+        return SUB + shift * SUB + static_cast<int>((value >> shift) - SUB);
+    }
+
+    inline uint64_t Metrics::bucketLow(int bucket) {
+        if (bucket < SUB) {
+            return bucket;
+        }
+        int shift = (bucket - SUB) / SUB;
+        return static_cast<uint64_t>(SUB + (bucket - SUB) % SUB) << shift;
+    }
+
+    inline uint64_t Metrics::bucketWidth(int bucket) {
+        return bucket < SUB ? 1 : uint64_t(1) << ((bucket - SUB) / SUB);
+    }
+
+    inline void Metrics::sample(bool lastRound) {
+        _rounds++;
+        if (_rounds % _interval != 0 && !lastRound) {
+            return;
+        }
+        LogWriter *log = LogWriter::instance();
+        for (int id = 0; id < (int)_counterNames.size(); id++) {
+            if (_counterLogged[id]) {
+                log->record(_counterNames[id], counterValue(id));
+            }
+        }
+        for (int id = 0; id < (int)_gaugeNames.size(); id++) {
+            GaugeValue &gauge = *_gaugeValues[id];
+            if (gauge.set.exchange(false)) {
+                double value = gauge.value.load();
+                // whole values are logged as integers, as they were before they went through a double
+                if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0) {
+                    log->record(_gaugeNames[id], static_cast<int64_t>(value));
+                }
+                else {
+                    log->record(_gaugeNames[id], value);
+                }
+            }
+        }
+        for (int id = 0; id < (int)_histogramNames.size(); id++) {
+            if (!_histogramLogged[id]) {
+                continue;
+            }
+            HistogramShard total;
+            histogramTotal(id, total);
+            const string &name = _histogramNames[id];
+            log->record(name + ".count", total.count.load());
+            log->record(name + ".mean", meanOf(total));
+            log->record(name + ".p50", percentileOf(total, 0.5));
+            log->record(name + ".p90", percentileOf(total, 0.9));
+            log->record(name + ".p99", percentileOf(total, 0.99));
+            log->record(name + ".max", total.max.load());
+        }
+    }
+
+    // a checkpoint holds the totals by name, which are restored into the calling thread's shard.
+    // Metrics the process has not registered yet, e.g. those registered on first use, are
+    // registered as they are restored
+    inline void Metrics::serialize(Checkpoint &archive) {
+        vector<string> counterNames = _counterNames;
+        vector<string> gaugeNames = _gaugeNames;
+        vector<string> histogramNames = _histogramNames;
+        vector<int64_t> counters(counterNames.size());
+        vector<double> gauges(gaugeNames.size());
+        vector<bool> gaugesSet(gaugeNames.size());
+        vector<vector<uint64_t>> histograms(histogramNames.size());
+        vector<int64_t> histogramSums(histogramNames.size());
+        vector<int64_t> histogramMaxima(histogramNames.size());
+        if (archive.saving()) {
+            for (size_t id = 0; id < counters.size(); id++) {
+                counters[id] = counterValue(id);
+            }
+            for (size_t id = 0; id < gauges.size(); id++) {
+                gauges[id] = _gaugeValues[id]->value.load();
+                gaugesSet[id] = _gaugeValues[id]->set.load();
+            }
+            for (size_t id = 0; id < histograms.size(); id++) {
+                HistogramShard total;
+                histogramTotal(id, total);
+                histograms[id].resize(BUCKETS);
+                for (int b = 0; b < BUCKETS; b++) {
+                    histograms[id][b] = total.buckets[b].load();
+                }
+                histogramSums[id] = total.sum.load();
+                histogramMaxima[id] = total.max.load();
+            }
+        }
+        int rounds = _rounds;
+        archive & rounds & counterNames & counters & gaugeNames & gauges & gaugesSet & histogramNames & histograms & histogramSums & histogramMaxima;
+        if (archive.restoring() && archive.good()) {
+            if (counters.size() != counterNames.size() || gauges.size() != gaugeNames.size() || gaugesSet.size() != gaugeNames.size()
+                || histograms.size() != histogramNames.size() || histogramSums.size() != histogramNames.size() || histogramMaxima.size() != histogramNames.size()) {
+                archive.fail("the checkpoint's metrics are damaged");
+                return;
+            }
+            reset();
+            _rounds = rounds;
+            Shard &shard = local();
+            for (size_t k = 0; k < counters.size(); k++) {
+                int id = counter(counterNames[k])._id;
+                if (id >= 0) {
+                    shard.counters[id].store(counters[k]);
+                }
+            }
+            for (size_t k = 0; k < gauges.size(); k++) {
+                int id = gauge(gaugeNames[k])._id;
+                if (id >= 0) {
+                    _gaugeValues[id]->value.store(gauges[k]);
+                    _gaugeValues[id]->set.store(gaugesSet[k]);
+                }
+            }
+            for (size_t k = 0; k < histograms.size(); k++) {
+                int id = histogram(histogramNames[k])._id;
+                if (id < 0) {
+                    continue;
+                }
+                HistogramShard &values = shard.histogram(id);
+                uint64_t count = 0;
+                for (size_t b = 0; b < BUCKETS && b < histograms[k].size(); b++) {
+                    values.buckets[b].store(histograms[k][b]);
+                    count += histograms[k][b];
+                }
+                values.count.store(count);
+                values.sum.store(histogramSums[k]);
+                values.max.store(histogramMaxima[k]);
+            }
+        }
+    }
+}
+
+#endif /* Metrics_hpp */
@@ -0,0 +1,297 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class streams the values recorded through LogWriter::record to a file as the run goes,
+// instead of keeping them in the log until the end. Values are gathered into batches that a
+// background thread encodes and writes; at most a fixed number of batches wait to be written, so
+// a run that records faster than the disk keeps up with is slowed down rather than growing.
+//
+// Each value is written as a row (test, round, metric, value) in one of three formats:
+//   csv      a header line, then one line per row
+//   ndjson   one json object per line
+//   binary   magic "QMET", version, then blocks. A block starts with its type and count: names
+//            (id, length, characters) give the metrics first used since the previous block, rows
+//            are four columns of count values each, test and round (int32), metric id (uint32) and
+//            value (double). Native endianness; convert with Tools/MetricsToCSV.
+
+#ifndef MetricsWriter_hpp
+#define MetricsWriter_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Json.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+
+    class MetricsWriter {
+    public:
+        static const uint32_t   MAGIC           = 0x54454d51; // "QMET"
+        static const uint32_t   VERSION         = 1;
+        enum Block : uint32_t { NAMES = 1, ROWS = 2 };
+        enum Format { CSV, NDJSON, BINARY };
+
+        // opens file and starts the writing thread, batches hold batchSize rows and at most
+        // queuedBatches of them wait to be written
+        MetricsWriter                           (const string &file, Format format, size_t batchSize = 4096, size_t queuedBatches = 4);
+        // writes everything recorded and stops the thread
+        ~MetricsWriter                          ();
+
+        bool                    good            ()const                 {return _good;};
+        void                    write           (int test, int round, const string &metric, double value);
+        // waits until everything recorded so far is written to the file
+        void                    flush           ();
+
+        // the format named by csv, ndjson or binary, or by the file's extension
+        static bool             formatOf        (const string &name, Format &format);
+        // the shortest text that reads back as value
+        static string           number          (double value);
+        // text as a csv field, quoted if it holds a comma, a quote or a line break
+        static string           csvField        (const string &text);
+        // text as a json string, quoted and escaped
+        static string           jsonString      (const string &text);
+
+    private:
+        struct Row {
+            int32_t             test;
+            int32_t             round;
+            uint32_t            metric;
+            double              value;
+        };
+        struct Batch {
+            vector<std::pair<uint32_t, string>> names;
+            vector<Row>         rows;
+        };
+
+        Format                  _format;
+        std::ofstream           _file;
+        bool                    _good;
+        size_t                  _batchSize;
+        size_t                  _queuedBatches;
+
+        // guards everything below
+        std::mutex              _mutex;
+        std::condition_variable _changed;
+        std::unordered_map<string, uint32_t> _ids;
+        Batch                   _current;
+        std::deque<Batch>       _queue;
+        // batches taken by the thread and not yet written
+        size_t                  _writing = 0;
+        bool                    _stopping = false;
+        std::thread             _thread;
+        // the names as the writing thread has seen them, only used by it
+        vector<string>          _written;
+
+        void                    hand            (std::unique_lock<std::mutex> &lock);
+        void                    run             ();
+        void                    encode          (const Batch &batch);
+    };
+
+    inline MetricsWriter::MetricsWriter(const string &file, Format format, size_t batchSize, size_t queuedBatches)
+        : _format(format), _batchSize(batchSize > 0 ? batchSize : 1), _queuedBatches(queuedBatches > 0 ? queuedBatches : 1) {
+        _file.open(file, format == BINARY ? std::ios::out | std::ios::binary : std::ios::out);
+        _good = !_file.fail();
+        if (!_good) {
+            std::cerr << "Error: could not open metrics file " << file << std::endl;
+            return;
+        }
+        if (format == BINARY) {
+            uint32_t header[2] = {MAGIC, VERSION};
+            _file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        }
+        else if (format == CSV) {
+            _file << "test,round,metric,value\n";
+        }
+        _current.rows.reserve(_batchSize);
+        _thread = std::thread(&MetricsWriter::run, this);
+    }
+
+    inline MetricsWriter::~MetricsWriter() {
+        if (!_good) {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            hand(lock);
+            _stopping = true;
+        }
+        _changed.notify_all();
+        _thread.join();
+        _file.close();
+    }
+
+    inline void MetricsWriter::write(int test, int round, const string &metric, double value) {
+        if (!_good) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto id = _ids.find(metric);
+        if (id == _ids.end()) {
+            id = _ids.emplace(metric, static_cast<uint32_t>(_ids.size())).first;
+            _current.names.emplace_back(id->second, metric);
+        }
+        _current.rows.push_back({test, round, id->second, value});
+        if (_current.rows.size() >= _batchSize) {
+            hand(lock);
+        }
+    }
+
+    // queues the current batch, waiting while the queue is full
+    inline void MetricsWriter::hand(std::unique_lock<std::mutex> &lock) {
+        if (_current.rows.empty() && _current.names.empty()) {
+            return;
+        }
+        _changed.wait(lock, [this] { return _queue.size() < _queuedBatches; });
+        _queue.push_back(std::move(_current));
+        _current = Batch();
+        _current.rows.reserve(_batchSize);
+        _changed.notify_all();
+    }
+
+    inline void MetricsWriter::flush() {
+        if (!_good) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        hand(lock);
+        _changed.wait(lock, [this] { return _queue.empty() && _writing == 0; });
+    }
+
+    inline void MetricsWriter::run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _changed.wait(lock, [this] { return !_queue.empty() || _stopping; });
+            if (_queue.empty()) {
+                return;
+            }
+            Batch batch = std::move(_queue.front());
+            _queue.pop_front();
+            _writing++;
+            _changed.notify_all();
+            lock.unlock();
+            encode(batch);
+            lock.lock();
+            _writing--;
+            _changed.notify_all();
+        }
+    }
+
+    inline void MetricsWriter::encode(const Batch &batch) {
+        if (_format == BINARY) {
+            if (!batch.names.empty()) {
+                uint32_t head[2] = {NAMES, static_cast<uint32_t>(batch.names.size())};
+                _file.write(reinterpret_cast<const char*>(head), sizeof(head));
+                for (const auto &name : batch.names) {
+                    uint32_t entry[2] = {name.first, static_cast<uint32_t>(name.second.size())};
+                    _file.write(reinterpret_cast<const char*>(entry), sizeof(entry));
+                    _file.write(name.second.data(), name.second.size());
+                }
+            }
+            if (!batch.rows.empty()) {
+                size_t count = batch.rows.size();
+                uint32_t head[2] = {ROWS, static_cast<uint32_t>(count)};
+                _file.write(reinterpret_cast<const char*>(head), sizeof(head));
+                vector<int32_t> tests(count), rounds(count);
+                vector<uint32_t> metrics(count);
+                vector<double> values(count);
+                for (size_t i = 0; i < count; i++) {
+                    tests[i] = batch.rows[i].test;
+                    rounds[i] = batch.rows[i].round;
+                    metrics[i] = batch.rows[i].metric;
+                    values[i] = batch.rows[i].value;
+                }
+                _file.write(reinterpret_cast<const char*>(tests.data()), count * sizeof(int32_t));
+                _file.write(reinterpret_cast<const char*>(rounds.data()), count * sizeof(int32_t));
+                _file.write(reinterpret_cast<const char*>(metrics.data()), count * sizeof(uint32_t));
+                _file.write(reinterpret_cast<const char*>(values.data()), count * sizeof(double));
+            }
+        }
+        else {
+            for (const auto &name : batch.names) {
+                if (_written.size() <= name.first) {
+                    _written.resize(name.first + 1);
+                }
+                // names are encoded once, as they are used in every row
+                _written[name.first] = _format == CSV ? csvField(name.second) : jsonString(name.second);
+            }
+            string text;
+            for (const Row &row : batch.rows) {
+                if (_format == CSV) {
+                    text += std::to_string(row.test) + "," + std::to_string(row.round) + "," + _written[row.metric] + "," + number(row.value) + "\n";
+                }
+                else {
+                    text += "{\"test\":" + std::to_string(row.test) + ",\"round\":" + std::to_string(row.round) + ",\"metric\":" + _written[row.metric] + ",\"value\":" + (std::isfinite(row.value) ? number(row.value) : "null") + "}\n";
+                }
+            }
+            _file << text;
+        }
+        _file.flush();
+    }
+
+    inline bool MetricsWriter::formatOf(const string &name, Format &format) {
+        string extension = name.substr(name.find_last_of('.') + 1);
+        if (extension == "csv") {
+            format = CSV;
+        }
+        else if (extension == "ndjson" || extension == "jsonl") {
+            format = NDJSON;
+        }
+        else if (extension == "binary" || extension == "bin" || extension == "qmet") {
+            format = BINARY;
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+
+    inline string MetricsWriter::number(double value) {
+        char text[32];
+        if (std::isfinite(value) && value == std::floor(value) && std::fabs(value) < 9007199254740992.0) {
+            std::snprintf(text, sizeof(text), "%lld", static_cast<long long>(value));
+            return text;
+        }
+        std::snprintf(text, sizeof(text), "%.15g", value);
+        if (std::strtod(text, nullptr) != value) {
+            std::snprintf(text, sizeof(text), "%.17g", value);
+        }
+        return text;
+    }
+
+    inline string MetricsWriter::csvField(const string &text) {
+        if (text.find_first_of(",\"\r\n") == string::npos) {
+            return text;
+        }
+        string field = "\"";
+        for (char c : text) {
+            field += c == '"' ? "\"\"" : string(1, c);
+        }
+        return field + "\"";
+    }
+
+    inline string MetricsWriter::jsonString(const string &text) {
+        return nlohmann::json(text).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    }
+}
+
+#endif /* MetricsWriter_hpp */
@@ -11,12 +11,21 @@ You should have received a copy of the GNU General Public License along with QUA
 // The underlaying data structure is a vector of peers(abstract class). It sets channel delays 
 // between peers when the network is initialized. These delays are between maximum and one. It 
 // is templated with a user defined message and peer class. 
+//
+// Initialization is spread over the simulation's thread pool: peers are constructed in parallel,
+// each topology computes the neighbor list of every peer independently of the others, and each
+// peer then opens the channels to its own neighbors.
+//
+// A topology may also carry a "trace" file of edges added and removed in later rounds (see
+// TopologyTrace.hpp), or generate them every round from a "dynamics" model (see DynamicGraph.hpp).
+// updateTopology applies each round's changes to the neighbor lists in place.
 
 
 #ifndef Network_hpp
 #define Network_hpp
 
 #include <stdio.h>
+#include <cstdlib>
 #include <vector>
 #include <string>
 #include <random>
@@ -28,8 +37,19 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <memory>
 #include <thread>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "Peer.hpp"
+#include "Checkpoint.hpp"
 #include "Distribution.hpp"
+#include "EdgeFile.hpp"
+#include "TopologyTrace.hpp"
+#include "DynamicGraph.hpp"
+#include "PeerCosts.hpp"
+#include "MemoryAccounting.hpp"
+#include "QueueTelemetry.hpp"
+#include "BS_thread_pool.hpp"
 
 namespace quantas{
 
@@ -48,11 +68,46 @@ namespace quantas{
     protected:
 
         vector<Peer<type_msg>*>             _peers;
-        Distribution                        _distribution;
+        // the channels' distributions, entry 0 is the experiment's
+        DelayTable                          _delays;
         ostream                             *_log;
-
-        void                                addEdges            (Peer<type_msg>*);
+        BS::thread_pool                     *_pool = nullptr;
+        // topology mapped from disk, kept so that per-edge delays and classes can be read when opening channels
+        std::shared_ptr<const EdgeFile>     _edgeFile;
+        // peers by id
+        vector<Peer<type_msg>*>             _directory;
+        // topology changes still to come, and the position of the next one
+        std::shared_ptr<const TopologyTrace> _trace;
+        size_t                              _traceCursor = 0;
+        // model generating topology changes, and the buffer they are generated into
+        std::unique_ptr<DynamicGraph>       _dynamics;
+        vector<TopologyEvent>               _changes;
+        // what each peer cost this test, if the experiment accounts for it
+        PeerCosts                           _costs;
+        // what the peers held in memory this test, if the experiment accounts for it
+        MemoryAccounting                    _memory;
+        // how deep the channels and inStreams were this test, if the experiment measures it
+        QueueTelemetry                      _queues;
+        // what went over each edge this test, if the experiment collects it
+        TrafficMatrix                       _traffic;
+        // packets put in the outStreams by the transmit phases of the run
+        std::atomic<uint64_t>               _packetsSent {0};
+
+        void                                addEdges            ();
+        // indexes the peers by id, here and for the interfaces
+        void                                buildDirectory      ();
         peer_type*							getPeerById			(string);
+        // runs loop(begin, end) over [0, n) on the thread pool, or inline if there is none
+        template<class F>
+        void                                parallelFor         (int n, F&& loop);
+        // sets the neighbors of the first numberOfPeers peers, neighborsOf(i, out) appends the positions of peer i's neighbors to out
+        template<class F>
+        void                                buildTopology       (int numberOfPeers, F&& neighborsOf);
+        // adds and removes the edges of [first, last)
+        void                                applyTopologyEvents (const TopologyEvent *first, const TopologyEvent *last);
+        // runs task(k) once on each thread of the pool, k numbering the threads from 0
+        template<class F>
+        void                                onEveryThread       (F&& task);
 
     public:
         Network                                                 ();
@@ -62,6 +117,7 @@ namespace quantas{
         // setters
         void                                initNetwork         (json, int); // initialize network with peers
         void                                initParameters(json);
+        void                                updateParameters(json);
         void                                fullyConnect        (int);
         void                                star                (int);
         void                                grid                (int, int);
@@ -70,17 +126,28 @@ namespace quantas{
         void                                ring                (int);
         void                                unidirectionalRing  (int);
         void                                userList            (json);
+        void                                edgeFile            (json);
 	    void                                dynamic             (int, int);
-        void                                setDistribution     (json distribution)                             { _distribution.setDistribution(distribution); }
+        void                                setDistribution     (json distribution)                             { _delays.setDistribution(distribution); }
         void                                setLog              (ostream&);
+        void                                setThreadPool       (BS::thread_pool *pool)                         { _pool = pool; }
         ostream*                            getLog              ()const                                         { return _log; }
+        // accounting of each peer's costs, see PeerCosts
+        void                                setCosts            (json costs)                                    { _costs.configure(costs); }
+        // accounting of the memory the peers hold, see MemoryAccounting
+        void                                setMemory           (json memory)                                   { _memory.configure(memory); }
+        // measurement of the channels' and inStreams' depths, see QueueTelemetry
+        void                                setQueues           (json queues)                                   { _queues.configure(queues); }
+        // collection of the traffic over each edge, see TrafficMatrix
+        void                                setTraffic          (json traffic)                                  { _traffic.configure(traffic); Peer<type_msg>::countTraffic(_traffic.enabled()); }
 
         // getters
         int                                 size                ()const                                         {return (int)_peers.size();};
-        int                                 maxDelay            ()const                                         {return _distribution.maxDelay();};
-        int                                 avgDelay            ()const                                         {return _distribution.avgDelay();};
-        int                                 minDelay            ()const                                         {return _distribution.minDelay();};
-        string                              type                ()const                                         {return _distribution.type();};
+        uint64_t                            packetsSent         ()const                                         {return _packetsSent.load();};
+        int                                 maxDelay            ()const                                         {return _delays[0].maxDelay();};
+        int                                 avgDelay            ()const                                         {return _delays[0].avgDelay();};
+        int                                 minDelay            ()const                                         {return _delays[0].minDelay();};
+        string                              type                ()const                                         {return _delays[0].type();};
 
 
         //mutators
@@ -88,9 +155,26 @@ namespace quantas{
         void                                performComputation  (int begin, int end);
         void                                endOfRound          ();
         void                                transmit            (int begin, int end);
+        // the hotspots of the test's peer costs, after writing them to the costs file
+        json                                reportCosts         (int test, const string &suffix = "");
+        // records what the peers held this round, false if that is over the budget and the run is to stop
+        bool                                endMemoryRound      (int test, int round)                           {return _memory.endRound(test, round);};
+        // what the peers held in memory over the test
+        json                                reportMemory        ()const;
+        // records how deep the queues were this round
+        void                                endQueueRound       (int round)                                     {_queues.endRound(round);};
+        // the depths of the queues over the test
+        json                                reportQueues        ()const                                         {return _queues.report();};
+        // the totals and top edges of the test's traffic, after writing the edges to the traffic file
+        json                                reportTraffic       (int test, const string &suffix = "");
         void                                makeRequest         (int i)                                         {_peers[i]->makeRequest();};
         void                                incrementRound();
         void                                initializeRound();
+        void                                updateTopology      (); // apply the topology changes of the current round
+        // saves or restores the state of the network between two rounds: the peers, their channels
+        // and the packets in flight, the topology's progress, the telemetry of the test so far and
+        // the random generators
+        void                                serialize           (Checkpoint &archive);
         // void                                shuffleByzantines   (int);
 
         // logging and debugging
@@ -109,7 +193,7 @@ namespace quantas{
     template<class type_msg, class peer_type>
     Network<type_msg,peer_type>::Network(){
         _peers = vector<Peer<type_msg>*>();
-        _distribution = Distribution();
+        _delays = DelayTable();
         _log = &cout;
     }
 
@@ -127,12 +211,13 @@ namespace quantas{
         for(int i = 0; i < rhs._peers.size(); i++){
             _peers.push_back(new peer_type(*dynamic_cast<peer_type*>(rhs._peers[i])));
         }
-        _distribution = rhs.distribution;
+        _delays = rhs._delays;
         _log = rhs._log;
     }
 
     template<class type_msg, class peer_type>
     Network<type_msg,peer_type>::~Network(){
+        NetworkInterface<type_msg>::setDirectory({}, nullptr);
         for(int i = 0; i < _peers.size(); i++){
             delete _peers[i];
         }
@@ -147,16 +232,107 @@ namespace quantas{
         }
 	}
 
+    template<class type_msg, class peer_type>
+    template<class F>
+    void Network<type_msg, peer_type>::parallelFor(int n, F&& loop) {
+        if (_pool == nullptr || n < 2) {
+            loop(0, n);
+            return;
+        }
+        _pool->parallelize_loop(n, loop).wait();
+    }
+
+    template<class type_msg, class peer_type>
+    template<class F>
+    void Network<type_msg, peer_type>::buildTopology(int numberOfPeers, F&& neighborsOf) {
+        parallelFor(numberOfPeers, [&](int begin, int end) {
+            vector<int> positions;
+            for (int i = begin; i < end; i++) {
+                positions.clear();
+                neighborsOf(i, positions);
+                vector<interfaceId> neighbors(positions.size());
+                for (size_t j = 0; j < positions.size(); j++) {
+                    neighbors[j] = _peers[positions[j]]->id();
+                }
+                _peers[i]->setNeighbors(std::move(neighbors));
+            }
+        });
+    }
+
+	// Opens a channel pair between every two peers where either one is the other's neighbor.
+	// The reverse adjacency is gathered first (counting sort keyed by target id) so that
+	// every peer can then open all of its channels without touching any other peer.
 	template<class type_msg, class peer_type>
-	void Network<type_msg, peer_type>::addEdges(Peer<type_msg>* peer) {
-		for (int i = 0; i < _peers.size() - 1; i++) {
-			int delay = _distribution.getDelay();
-            
-			
-            // Both directions have the same delay
-			peer->addChannel(*_peers[i], delay);
-			_peers[i]->addChannel(*peer, delay);
+	void Network<type_msg, peer_type>::buildDirectory() {
+		_directory.assign(_peers.size(), nullptr);
+		for (Peer<type_msg> *peer : _peers) {
+			if (peer->id() >= 0 && peer->id() < (interfaceId)_peers.size()) {
+				_directory[peer->id()] = peer;
+			}
 		}
+		NetworkInterface<type_msg>::setDirectory(vector<NetworkInterface<type_msg>*>(_directory.begin(), _directory.end()), &_delays);
+	}
+
+	template<class type_msg, class peer_type>
+	void Network<type_msg, peer_type>::addEdges() {
+		int networkSize = (int)_peers.size();
+		_delays.reseedChannels();
+		buildDirectory();
+		auto valid = [networkSize](interfaceId id) { return id >= 0 && id < networkSize; };
+
+		vector<std::atomic<long>> inDegree(networkSize + 1);
+		parallelFor(networkSize, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				for (interfaceId neighbor : _peers[i]->neighbors()) {
+					if (valid(neighbor)) {
+						inDegree[neighbor + 1].fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			}
+		});
+		vector<long> offsets(networkSize + 1, 0);
+		for (int i = 0; i < networkSize; i++) {
+			offsets[i + 1] = offsets[i] + inDegree[i + 1].load();
+			inDegree[i + 1] = offsets[i];
+		}
+		vector<interfaceId> sources(offsets[networkSize]);
+		parallelFor(networkSize, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				for (interfaceId neighbor : _peers[i]->neighbors()) {
+					if (valid(neighbor)) {
+						sources[inDegree[neighbor + 1].fetch_add(1, std::memory_order_relaxed)] = _peers[i]->id();
+					}
+				}
+			}
+		});
+
+		const EdgeFile *edges = _edgeFile && (_edgeFile->hasDelays() || _edgeFile->hasClasses()) ? _edgeFile.get() : nullptr;
+		parallelFor(networkSize, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				interfaceId self = _peers[i]->id();
+				vector<interfaceId> partners = _peers[i]->neighbors();
+				partners.insert(partners.end(), sources.begin() + offsets[self], sources.begin() + offsets[self + 1]);
+				std::sort(partners.begin(), partners.end());
+				partners.erase(std::unique(partners.begin(), partners.end()), partners.end());
+				for (interfaceId partner : partners) {
+					if (valid(partner) && partner != self) {
+						// Both directions have the same delay unless the edge file says otherwise
+						ChannelDelay delay = _delays.channelDelay(self, partner, edges != nullptr ? edges->channelClass(i, partner) : 0);
+						int fileDelay = edges != nullptr ? edges->delay(i, partner) : 0;
+						if (fileDelay != 0) {
+							delay.maxDelay = (uint16_t)fileDelay;
+						}
+						_peers[i]->addChannel(*_directory[partner], delay);
+					}
+				}
+			}
+		});
+		// every channel is open, so each peer can look up the ones to its neighbors
+		parallelFor(networkSize, [this](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				_peers[i]->bindLinks();
+			}
+		});
 	}
 
 	template<class type_msg, class peer_type>
@@ -164,11 +340,14 @@ namespace quantas{
 	    for (int i = 0; i < _peers.size(); i++) {
             delete _peers[i];
         }
-        _peers = vector<Peer<type_msg>*>();
-		for (int i = 0; i < topology["totalPeers"]; i++) {
-			_peers.push_back(new peer_type(i));
-			addEdges(_peers[i]);
-		}
+        _edgeFile.reset();
+        int totalPeers = topology["totalPeers"];
+        _peers = vector<Peer<type_msg>*>(totalPeers, nullptr);
+        parallelFor(totalPeers, [this](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                _peers[i] = new peer_type(i);
+            }
+        });
         if (topology["identifiers"] == "random") {
             // randomly shuffle nodes prior to setting up topology
             std::shuffle(_peers.begin(),_peers.end(), RANDOM_GENERATOR);
@@ -197,6 +376,12 @@ namespace quantas{
         }
         else if (topology["type"] == "userList") {
             userList(topology);
+        }
+        else if (topology["type"] == "edgeFile") {
+            edgeFile(topology);
+        }
+        else if (topology["type"] == "empty") {
+            // no edges, they all come from the dynamics or the trace
         }
 	    else if (topology["type"] == "dynamic") {
             dynamic(topology["initialPeers"], topology["sourcePoolSize"]);
@@ -204,8 +389,41 @@ namespace quantas{
         else {
             std::cerr << "Error: need an input file" << std::endl;
         }
+        addEdges();
+
+        _trace.reset();
+        _traceCursor = 0;
+        if (topology.contains("trace")) {
+            string path = topology["trace"];
+            try {
+                _trace = TopologyTrace::open(path);
+            }
+            catch (const std::exception &e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+        }
+
+        _dynamics.reset();
+        if (topology.contains("dynamics")) {
+            int numberOfPeers = topology.contains("initialPeers") ? (int)topology["initialPeers"] : totalPeers;
+            _dynamics = DynamicGraph::create(topology["dynamics"], numberOfPeers);
+            if (_dynamics && _dynamics->usesBaseTopology()) {
+                // the model takes the edges over, they only appear once it brings them in
+                vector<EdgeRotation::Edge> edges;
+                for (int i = 0; i < totalPeers; i++) {
+                    for (interfaceId neighbor : _peers[i]->neighbors()) {
+                        edges.push_back({(uint32_t)_peers[i]->id(), (uint32_t)neighbor});
+                    }
+                    _peers[i]->setNeighbors({});
+                }
+                _dynamics->setBaseTopology(std::move(edges));
+            }
+        }
         Peer<type_msg>::initializeRound();
 	    Peer<type_msg>::initializeLastRound(lastRound -1);
+        _costs.reset(_peers.size());
+        _memory.reset(_peers.size());
+        _queues.reset();
 	}
 	
     template<class type_msg, class peer_type>
@@ -213,167 +431,414 @@ namespace quantas{
         _peers[0]->initParameters(_peers, parameters);
     }
 
+    template<class type_msg, class peer_type>
+    void Network<type_msg, peer_type>::updateParameters(json parameters) {
+        _peers[0]->updateParameters(_peers, parameters);
+    }
+
+    // Each topology below lists the neighbors of a peer in the order they would be added by
+    // walking the peers in turn and connecting each one to the peers before it.
+
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::fullyConnect(int numberOfPeers) {
-        for (int i = 0; i < numberOfPeers; i++) {
-            // Activate peer
-            for (int j = i+1; j < numberOfPeers; j++) {
-                _peers[i]->addNeighbor(_peers[j]->id());
-                _peers[j]->addNeighbor(_peers[i]->id());
+        buildTopology(numberOfPeers, [numberOfPeers](int i, vector<int> &out) {
+            out.reserve(numberOfPeers - 1);
+            for (int j = 0; j < numberOfPeers; j++) {
+                if (j != i) {
+                    out.push_back(j);
+                }
             }
-        }
+        });
     }
 
     // Connects all peers to peer 0
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::star(int numberOfPeers) {
-        for (int i = 1; i < numberOfPeers; i++) {
-            // Activate peer
-            _peers[0]->addNeighbor(_peers[i]->id());
-            _peers[i]->addNeighbor(_peers[0]->id());
-        }
+        buildTopology(numberOfPeers, [numberOfPeers](int i, vector<int> &out) {
+            if (i == 0) {
+                for (int j = 1; j < numberOfPeers; j++) {
+                    out.push_back(j);
+                }
+            }
+            else {
+                out.push_back(0);
+            }
+        });
     }
 
 	template<class type_msg, class peer_type>
 	void Network<type_msg, peer_type>::grid(int height, int width) {
-		for (int i = 0; i < height; i++) {
-			for (int j = 0; j < width; j++) {
-				// Activate peer
-				int num = i * width + j;
-				if (i == 0) {
-					// Top row adds only left neighbor
-					if (j != 0) {
-						_peers[num]->addNeighbor(_peers[num - 1]->id());
-						_peers[num - 1]->addNeighbor(_peers[num]->id());
-					}
-				}
-				else {
-					// Left column adds only above neighbor
-					_peers[num]->addNeighbor(_peers[num - width]->id());
-					_peers[num - width]->addNeighbor(_peers[num]->id());
-					// All others add both left and above
-					if (j != 0) {
-						_peers[num]->addNeighbor(_peers[num - 1]->id());
-						_peers[num - 1]->addNeighbor(_peers[num]->id());
-					}
-				}
+		buildTopology(height * width, [height, width](int num, vector<int> &out) {
+			int i = num / width;
+			int j = num % width;
+			// above and left are added when num is activated, right and below when they are
+			if (i != 0) {
+				out.push_back(num - width);
 			}
-		}
+			if (j != 0) {
+				out.push_back(num - 1);
+			}
+			if (j != width - 1) {
+				out.push_back(num + 1);
+			}
+			if (i != height - 1) {
+				out.push_back(num + width);
+			}
+		});
 	}
 
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::torus(int height, int width) {
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                // Activate peer
-                int num = i * width + j;
-                if (i == 0) {
-                    // Top row adds only left neighbor
-                    if (j != 0) {
-                        _peers[num]->addNeighbor(_peers[num - 1]->id());
-                        _peers[num - 1]->addNeighbor(_peers[num]->id());
-                    }
-                    // Right column creates torus
-                    if (j == width - 1) {
-                        _peers[num]->addNeighbor(_peers[num - j]->id());
-                        _peers[num - j]->addNeighbor(_peers[num]->id());
-                    }
-                }
-                else {
-                    // Left column adds only above neighbor
-                    _peers[num]->addNeighbor(_peers[num - width]->id());
-                    _peers[num - width]->addNeighbor(_peers[num]->id());
-                    // All others add both left and above
-                    if (j != 0) {
-                        _peers[num]->addNeighbor(_peers[num - 1]->id());
-                        _peers[num - 1]->addNeighbor(_peers[num]->id());
-                    }
-                    // Right column creates torus
-                    if (j == width - 1) {
-                        _peers[num]->addNeighbor(_peers[num - j]->id());
-                        _peers[num - j]->addNeighbor(_peers[num]->id());
-                    }
-                    // Bottom row creates torus
-                    if (i == height - 1) {
-                        _peers[num]->addNeighbor(_peers[j]->id());
-                        _peers[j]->addNeighbor(_peers[num]->id());
-                    }
+        buildTopology(height * width, [height, width](int num, vector<int> &out) {
+            int i = num / width;
+            int j = num % width;
+            // edges added when num is activated
+            if (i != 0) {
+                out.push_back(num - width);
+            }
+            if (j != 0) {
+                out.push_back(num - 1);
+            }
+            // Right column creates torus (a single column wraps onto itself from both ends)
+            if (j == width - 1) {
+                out.push_back(num - j);
+                if (j == 0) {
+                    out.push_back(num);
                 }
             }
-        }
+            // Bottom row creates torus
+            if (i != 0 && i == height - 1) {
+                out.push_back(j);
+            }
+            // edges added when the peers after num are activated
+            if (j != width - 1) {
+                out.push_back(num + 1);
+            }
+            if (j == 0 && width > 1) {
+                out.push_back(num + width - 1);
+            }
+            if (i != height - 1) {
+                out.push_back(num + width);
+            }
+            if (i == 0 && height > 1) {
+                out.push_back((height - 1) * width + j);
+            }
+        });
     }
 
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::chain(int numberOfPeers) {
-        for (int i = 1; i < numberOfPeers; i++) {
-            // Activate peer
-            _peers[i]->addNeighbor(_peers[i-1]->id());
-            _peers[i-1]->addNeighbor(_peers[i]->id());
-        }
+        buildTopology(numberOfPeers, [numberOfPeers](int i, vector<int> &out) {
+            if (i != 0) {
+                out.push_back(i - 1);
+            }
+            if (i != numberOfPeers - 1) {
+                out.push_back(i + 1);
+            }
+        });
     }
 
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::ring(int numberOfPeers) {
-        for (int i = 1; i < numberOfPeers; i++) {
-            // Activate peer
-            _peers[i]->addNeighbor(_peers[i - 1]->id());
-            _peers[i - 1]->addNeighbor(_peers[i]->id());
-        }
-        _peers[0]->addNeighbor(_peers[numberOfPeers - 1]->id());
-        _peers[numberOfPeers - 1]->addNeighbor(_peers[0]->id());
+        buildTopology(numberOfPeers, [numberOfPeers](int i, vector<int> &out) {
+            if (i != 0) {
+                out.push_back(i - 1);
+            }
+            if (i != numberOfPeers - 1) {
+                out.push_back(i + 1);
+            }
+            // closing the ring
+            if (i == 0) {
+                out.push_back(numberOfPeers - 1);
+            }
+            if (i == numberOfPeers - 1) {
+                out.push_back(0);
+            }
+        });
     }
 
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::unidirectionalRing(int numberOfPeers) {
-        for (int i = 1; i < numberOfPeers; i++) {
-            // Activate peer
-            _peers[i - 1]->addNeighbor(_peers[i]->id());
-        }
-        _peers[numberOfPeers - 1]->addNeighbor(_peers[0]->id());
+        buildTopology(numberOfPeers, [numberOfPeers](int i, vector<int> &out) {
+            out.push_back((i + 1) % numberOfPeers);
+        });
     }
 
+    // Streams the list in a single pass, copying each peer's links straight into its neighbors
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::userList(json topology) {
-        json list = topology["list"];
-        for (int i = 0; i < topology["totalPeers"]; i++) {
-            if (list.contains(std::to_string(i))) {
-                json comLinks = list[std::to_string(i)];
-                for (int j = 0; j < comLinks.size(); j++) {
-                    _peers[i]->addNeighbor(comLinks[j]);
-                }
+        const json &list = topology["list"];
+        int totalPeers = topology["totalPeers"];
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            const string &key = it.key();
+            char *rest = nullptr;
+            long i = std::strtol(key.c_str(), &rest, 10);
+            if (key.empty() || *rest != '\0') {
+                std::cerr << "Error: userList key " << key << " is not a peer id, skipping it" << std::endl;
+                continue;
             }
+            if (i < 0 || i >= totalPeers) {
+                continue;
+            }
+            const json &comLinks = it.value();
+            vector<interfaceId> neighbors;
+            neighbors.reserve(comLinks.size());
+            for (auto link = comLinks.begin(); link != comLinks.end(); ++link) {
+                neighbors.push_back(link->template get<interfaceId>());
+            }
+            _peers[i]->setNeighbors(std::move(neighbors));
         }
     }
 
+    // Like userList, but the lists come from a memory-mapped CSR file (see EdgeFile.hpp)
+    template<class type_msg, class peer_type>
+    void Network<type_msg, peer_type>::edgeFile(json topology) {
+        string path = topology["file"];
+        try {
+            _edgeFile = EdgeFile::open(path);
+        }
+        catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            _edgeFile.reset();
+            return;
+        }
+        const EdgeFile &edges = *_edgeFile;
+        int numberOfPeers = (int)std::min<uint64_t>(edges.nodes(), _peers.size());
+        parallelFor(numberOfPeers, [this, &edges](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                _peers[i]->setNeighbors(vector<interfaceId>(edges.begin(i), edges.end(i)));
+            }
+        });
+    }
+
     // addNeighbor() adds peer to peer's _neighbors vector. I.e., it determines who the peer can broadcast to.
+    // Peers outside the source pool only hear from other peers outside of it.
     template<class type_msg, class peer_type>
     void Network<type_msg, peer_type>::dynamic(int numberOfPeers, int sourcePoolSize) {
         Peer<type_msg>::initializeSourcePoolSize(sourcePoolSize);
-        for (int i = 0; i < numberOfPeers; ++i) {
+        buildTopology(numberOfPeers, [numberOfPeers, sourcePoolSize](int i, vector<int> &out) {
+            for (int j = 0; j < i; ++j) {
+                if (!(i >= sourcePoolSize && j < sourcePoolSize)) {
+                    out.push_back(j);
+                }
+            }
             for (int j = i + 1; j < numberOfPeers; ++j) {
-                if (j >= sourcePoolSize && !(i >= sourcePoolSize)) { // if peer[j] isn't apart of the source pool but peer[i] is...
-                    _peers[i]->addNeighbor(_peers[j]->id());   
-	        }
+                out.push_back(j);
+            }
+        });
+    }
+
+    template<class type_msg, class peer_type>
+    void Network<type_msg, peer_type>::updateTopology() {
+        uint32_t round = Peer<type_msg>::getRound();
+        if (_trace) {
+            const TopologyEvent *first = _trace->begin() + _traceCursor;
+            const TopologyEvent *last = first;
+            while (last != _trace->end() && last->round <= round) {
+                ++last;
+            }
+            applyTopologyEvents(first, last);
+            _traceCursor = last - _trace->begin();
+            _trace->release(_traceCursor);
+        }
+        if (_dynamics) {
+            _changes.clear();
+            _dynamics->step(round, _changes);
+            std::stable_sort(_changes.begin(), _changes.end(), [](const TopologyEvent &a, const TopologyEvent &b) { return a.source < b.source; });
+            applyTopologyEvents(_changes.data(), _changes.data() + _changes.size());
+        }
+    }
 
-                else {
-                    _peers[i]->addNeighbor(_peers[j]->id());
-                    _peers[j]->addNeighbor(_peers[i]->id());
+    // The events of a round are grouped by source. Each group only changes the neighbors of its
+    // own peer (addNeighbor locks both ends when it opens a channel), so groups run in parallel.
+    template<class type_msg, class peer_type>
+    void Network<type_msg, peer_type>::applyTopologyEvents(const TopologyEvent *first, const TopologyEvent *last) {
+        auto apply = [this](const TopologyEvent *begin, const TopologyEvent *end) {
+            for (const TopologyEvent *event = begin; event != end; ++event) {
+                if (event->source >= _directory.size() || event->target >= _directory.size()) {
+                    continue;
                 }
+                Peer<type_msg> *peer = _directory[event->source];
+                if (event->op == TopologyEvent::ADD_EDGE) {
+                    if (!peer->isNeighbor(event->target)) {
+                        peer->addNeighbor(event->target);
+                    }
+                }
+                else if (event->op == TopologyEvent::REMOVE_EDGE) {
+                    peer->removeNeighbor(event->target);
+                }
+            }
+        };
+
+        vector<const TopologyEvent*> groups;
+        for (const TopologyEvent *event = first; event != last; ++event) {
+            if (event == first || event->source != (event - 1)->source) {
+                if (event != first && event->source < (event - 1)->source) {
+                    // not grouped by source, a peer could be changed from two threads
+                    apply(first, last);
+                    return;
+                }
+                groups.push_back(event);
+            }
+        }
+        groups.push_back(last);
+        parallelFor((int)groups.size() - 1, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                apply(groups[i], groups[i + 1]);
             }
+        });
+    }
+
+    template<class type_msg, class peer_type>
+    template<class F>
+    void Network<type_msg, peer_type>::onEveryThread(F&& task) {
+        if (_pool == nullptr) {
+            return;
+        }
+        // every task waits until all have started, so no thread can run two of them
+        unsigned threads = _pool->get_thread_count();
+        std::mutex mutex;
+        std::condition_variable allStarted;
+        unsigned started = 0;
+        vector<std::future<void>> done;
+        for (unsigned i = 0; i < threads; i++) {
+            done.push_back(_pool->submit([&]() {
+                unsigned k;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    k = started++;
+                    allStarted.notify_all();
+                    allStarted.wait(lock, [&]() { return started == threads; });
+                }
+                task(k);
+            }));
+        }
+        for (std::future<void> &thread : done) {
+            thread.wait();
+        }
+    }
+
+    // Runs with more than one thread are not reproducible to begin with, as which thread draws
+    // which random numbers varies, so the generators of the pool's threads are matched up in
+    // whatever order they start. With one thread the restored run continues bit for bit.
+    template<class type_msg, class peer_type>
+    void Network<type_msg, peer_type>::serialize(Checkpoint &archive) {
+        int round = Peer<type_msg>::getRound();
+        int sourcePoolSize = Peer<type_msg>::getSourcePoolSize();
+        uint64_t peers = _peers.size();
+        archive & round & sourcePoolSize & peers;
+        if (archive.restoring() && peers != _peers.size()) {
+            archive.fail("the checkpoint has " + std::to_string(peers) + " peers, the network " + std::to_string(_peers.size()));
+        }
+        if (!archive.good()) {
+            return;
+        }
+        Peer<type_msg>::setRound(round);
+        Peer<type_msg>::initializeSourcePoolSize(sourcePoolSize);
+
+        // identifiers may have been shuffled
+        for (Peer<type_msg> *peer : _peers) {
+            interfaceId id = peer->id();
+            archive & id;
+            peer->setID(id);
+        }
+        vector<unsigned long long> seeds = _delays.channelSeeds();
+        archive & seeds;
+        if (archive.restoring()) {
+            _delays.setChannelSeeds(seeds);
+            buildDirectory();
+        }
+
+        bool dynamics = _dynamics != nullptr;
+        archive & _traceCursor & dynamics;
+        if (dynamics != (_dynamics != nullptr)) {
+            archive.fail("the checkpoint was taken with other topology dynamics");
+            return;
+        }
+        if (_dynamics) {
+            _dynamics->serialize(archive);
+        }
+
+        for (Peer<type_msg> *peer : _peers) {
+            peer->serializeChannels(archive);
+            peer->serialize(archive);
+        }
+        if (archive.restoring() && archive.good()) {
+            parallelFor((int)_peers.size(), [this](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    _peers[i]->bindLinks();
+                }
+            });
+        }
+
+        _costs.serialize(archive);
+        _memory.serialize(archive);
+        _queues.serialize(archive);
+        _traffic.serialize(archive);
+        uint64_t packetsSent = _packetsSent.load();
+        archive & packetsSent;
+        if (archive.restoring() && archive.good()) {
+            _packetsSent.store(packetsSent);
+        }
+
+        archive.engine(RANDOM_GENERATOR);
+        archive & BATCH_GENERATOR;
+        vector<string> threadGenerators(_pool == nullptr ? 0 : _pool->get_thread_count());
+        onEveryThread([&](unsigned k) {
+            if (archive.saving()) {
+                std::ostringstream state;
+                state << RANDOM_GENERATOR << ' ' << BATCH_GENERATOR.state();
+                threadGenerators[k] = state.str();
+            }
+        });
+        archive & threadGenerators;
+        if (archive.restoring() && archive.good()) {
+            onEveryThread([&](unsigned k) {
+                if (k < threadGenerators.size()) {
+                    std::istringstream state(threadGenerators[k]);
+                    uint64_t batch;
+                    state >> RANDOM_GENERATOR >> batch;
+                    BATCH_GENERATOR = BatchGenerator(batch);
+                }
+            });
         }
     }
 
     template<class type_msg, class peer_type>
     void Network<type_msg,peer_type>::receive(int begin, int end){
+        QueueDepths depths;
+        QueueDepths *noted = _queues.enabled() ? &depths : nullptr;
+        MemoryAccounting::Totals held;
         for (int i = begin; i < end; i++) {
-		    _peers[i]->receive();
+		    _peers[i]->receive(noted);
+            if (_costs.enabled()) {
+                _costs.received(i, _peers[i]->inStreamSize());
+            }
+            // the inbound channels are only written by transmit, so they hold still here
+            if (_memory.enabled()) {
+                _memory.accountChannels(i, *_peers[i], held);
+            }
 	    }
+        if (noted != nullptr) {
+            _queues.add(depths);
+        }
+        if (_memory.enabled()) {
+            _memory.add(held);
+        }
     }
 
     template<class type_msg, class peer_type>
     void Network<type_msg,peer_type>::performComputation(int begin, int end){
+        if (!_costs.enabled()) {
+            for (int i = begin; i < end; i++) {
+                _peers[i]->performComputation();
+            }
+            return;
+        }
         for (int i = begin; i < end; i++) {
+            auto start = std::chrono::steady_clock::now();
             _peers[i]->performComputation();
+            _costs.computed(i, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), _peers[i]->inStreamSize());
         }
     }
 
@@ -385,9 +850,56 @@ namespace quantas{
 
     template<class type_msg, class peer_type>
     void Network<type_msg,peer_type>::transmit(int begin, int end){
+        uint64_t sent = 0;
+        MemoryAccounting::Totals held;
         for (int i = begin; i < end; i++) {
+            sent += _peers[i]->outStreamSize();
+            if (_costs.enabled()) {
+                _costs.transmitted(i, _peers[i]->outStreamSize());
+            }
+            // the peer's streams are at their fullest before its outStream is sent
+            if (_memory.enabled()) {
+                _memory.accountStreams(i, *_peers[i], held);
+            }
             _peers[i]->transmit();
         }
+        _packetsSent.fetch_add(sent, std::memory_order_relaxed);
+        if (_memory.enabled()) {
+            _memory.add(held);
+        }
+    }
+
+    template<class type_msg, class peer_type>
+    json Network<type_msg,peer_type>::reportCosts(int test, const string &suffix){
+        vector<long> ids(_peers.size());
+        for (size_t i = 0; i < _peers.size(); i++) {
+            ids[i] = _peers[i]->id();
+        }
+        return _costs.report(test, ids, suffix);
+    }
+
+    template<class type_msg, class peer_type>
+    json Network<type_msg,peer_type>::reportMemory()const{
+        vector<long> ids(_peers.size());
+        for (size_t i = 0; i < _peers.size(); i++) {
+            ids[i] = _peers[i]->id();
+        }
+        return _memory.report(ids);
+    }
+
+    template<class type_msg, class peer_type>
+    json Network<type_msg,peer_type>::reportTraffic(int test, const string &suffix){
+        if (!_traffic.enabled()) {
+            return json();
+        }
+        vector<TrafficMatrix::Edge> edges;
+        for (Peer<type_msg> *peer : _peers) {
+            long source = peer->id();
+            peer->forEachTraffic([&](interfaceId target, const LinkTraffic &traffic) {
+                edges.push_back({source, target, traffic});
+            });
+        }
+        return _traffic.report(test, edges, suffix);
     }
 
     template<class type_msg, class peer_type>
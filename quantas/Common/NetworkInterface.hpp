@@ -48,6 +48,39 @@ You should have received a copy of the GNU General Public License along with QUA
 // NetworkInterface in the target peer). <<SEND>> pushes the packet into the _inBoundChannel of the 
 // tagets Peers networkInterface
 //
+// === OPENING CHANNELS ===
+// Channels are only opened between interfaces that are neighbors (in either direction). The
+// network opens them in bulk once the topology is built. When a neighbor is added later on,
+// <<addNeighbor>> opens the channel pair itself, looking the other interface up in the static
+// directory of interfaces by id. Both ends of a channel get the same delay.
+//
+// === CHANNEL DELAYS ===
+// A channel's delay parameters are a ChannelDelay: the index of the distribution its packets
+// follow in the network's DelayTable, and the maximum delay drawn for it. Alongside <_neighbors>
+// each interface keeps <_links>, the channel to each neighbor (the inbound queue at the other end
+// and its ChannelDelay) at the same position, so transmit finds both without a map lookup.
+// Only the maximum delay follows the channel's distribution: a packet's delay is drawn uniformly
+// from [max(1, minDelay), maxDelay], the delays of a whole outStream in one batch.
+//
+// === TRACING ===
+// While a trace is open (see Tracer) transmit records every packet it sends or drops, with its
+// delay, and receive every packet it moves to <_inStream>. The check is made once per call.
+// The same events are static probes (see Probes.hpp) when those are compiled in.
+//
+// === QUEUE DEPTHS ===
+// Given a QueueDepths, receive also notes the packets left on each channel once the arrived ones
+// are moved, and the length of <_inStream> after them (see QueueTelemetry).
+//
+// === TRAFFIC ===
+// While traffic is counted (see TrafficMatrix) transmit adds each packet it puts on a channel to
+// <_traffic>, kept in the order of _neighbors like <_links>. A neighbor's traffic moves to
+// <_pastTraffic> when it is removed.
+//
+// === LATENCY ===
+// While delivery latency is measured (see DeliveryLatency) receive records each packet it moves,
+// with the delay class of its channel, looked up at the sending end (the classes of a directed
+// edge file differ by direction) once per channel that delivers.
+//
 
 
 #ifndef NetworkInterface_hpp
@@ -62,7 +95,13 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <iomanip>
 #include <algorithm>
 #include <iterator>
+#include <mutex>
 #include "Packet.hpp"
+#include "Tracer.hpp"
+#include "Probes.hpp"
+#include "QueueTelemetry.hpp"
+#include "TrafficMatrix.hpp"
+#include "DeliveryLatency.hpp"
 
 namespace quantas{
 
@@ -90,17 +129,39 @@ namespace quantas{
     private:
         
         typedef deque<Packet<message> >                 aChannel;
+        // the channel to a neighbor, as seen from the sending end
+        struct Link {
+            aChannel                                    *channel = nullptr; // inbound channel at the neighbor
+            ChannelDelay                                delay;
+        };
 
         interfaceId                                     _id;
         map<interfaceId,aChannel>                       _inBoundChannels;// channels from all other interfaces into this interface
-        map<interfaceId,int>                            _outBoundChannelDelays;// list of channels delays by there target interface id
+        map<interfaceId,ChannelDelay>                   _outBoundChannelDelays;// list of channels delays by there target interface id
         map<interfaceId, NetworkInterface<message>* >   _outBoundChannels; // list of all other interfaces in the network (weather they are a neighbor or not) use send to send them a message
         deque<Packet<message> >                         _inStream;// messages that have arrived at this peer
         deque<Packet<message> >                         _outStream;// messages waiting to be sent by this peer
         vector<interfaceId>                             _neighbors; // list of interfaces that are directly connected to this one (i.e. they can send messages directly to each other)
+        vector<Link>                                    _links; // channel to each neighbor, in the order of _neighbors
+        std::mutex                                      _channelMutex; // guards the channel maps while a channel is opened mid-round
+        vector<LinkTraffic>                             _traffic; // sent to each neighbor, in the order of _neighbors, grown as they are added
+        map<interfaceId, LinkTraffic>                   _pastTraffic; // sent to neighbors since removed
+
+        // every interface in the network by id, and the delays of the channels between them
+        static vector<NetworkInterface<message>*>       _directory;
+        static const DelayTable*                        _delayTable;
+        static bool                                     _countingTraffic;
         
-         // send a message to this peer
-        void                               send                  (Packet<message>);
+        // open the channels to and from neighborId if there are none yet, and return the one to it
+        Link                               connect               (interfaceId neighborId);
+        // the channel to neighborId, the channels must be open and not changing
+        Link                               linkTo                (interfaceId neighborId);
+        // the delay class of the channel from senderId to this interface, as the sender has it
+        int                                classFrom             (interfaceId senderId)const;
+        // moves the traffic to every neighbor to <_pastTraffic>
+        void                               retireTraffic         ();
+        // saves or restores a queue of packets, which have no public default constructor
+        static void                        serializeQueue        (Checkpoint &archive, aChannel &queue);
 
     protected:
         
@@ -124,6 +185,9 @@ namespace quantas{
         void                               setLogFile            (ostream &o)                               {_log = &o;};
         void                               printNeighborhoodOn   ()                                         {_printNeighborhood = true;}
         void                               printNeighborhoodOff  ()                                         {_printNeighborhood = false;}
+        static void                        setDirectory          (vector<NetworkInterface<message>*> directory, const DelayTable *delays) {_directory = std::move(directory); _delayTable = delays;};
+        // counts the packets transmit puts on each channel, see TrafficMatrix
+        static void                        countTraffic          (bool counting)                            {_countingTraffic = counting;};
         
         // getters
         vector<interfaceId>                neighbors             ()const                                    {return _neighbors;};
@@ -135,18 +199,33 @@ namespace quantas{
         size_t                             inStreamSize          ()const                                    {return _inStream.size();};
         bool                               outStreamEmpty        ()const                                    {return _outStream.empty();};
         bool                               inStreamEmpty         ()const                                    {return _inStream.empty();};
+        // bytes held by the packets in flight to this interface, and by those in its in and out streams
+        size_t                             channelBytes          ()const;
+        size_t                             streamBytes           ()const                                    {return (_inStream.size() + _outStream.size()) * sizeof(Packet<message>);};
+        // calls edge(target, traffic) for each interface this one sent packets to over a channel
+        template<class F>
+        void                               forEachTraffic        (F&& edge)const;
 
         // mutators
         void                               removeChannel         (const NetworkInterface &neighbor)         {_outBoundChannels.erase(neighbor);};
-        void                               addChannel            (NetworkInterface &newNeighbor, int delay);
+        void                               addChannel            (NetworkInterface &newNeighbor, int delay)   {addChannel(newNeighbor, ChannelDelay{0, (uint16_t)std::max(1, std::min(delay, (int)UINT16_MAX))});};
+        void                               addChannel            (NetworkInterface &newNeighbor, ChannelDelay delay);
+        // looks up the channel to every neighbor once all channels are open
+        void                               bindLinks             ();
+        // saves or restores the neighbors, the open channels with the packets in flight on them and
+        // the in and out streams. Restoring needs the directory set, and bindLinks afterwards.
+        void                               serializeChannels     (Checkpoint &archive);
         void                               clearMessages         ();
         void                               pushToOutSteam        (Packet<message> outMsg)                   {_outStream.push_back(outMsg);};
         Packet<message>                    popInStream           ();
-        void                               addNeighbor           (interfaceId neighborIdAdd)                {_neighbors.push_back(neighborIdAdd);};
+        void                               addNeighbor           (interfaceId neighborIdAdd)                {_neighbors.push_back(neighborIdAdd); _links.push_back(connect(neighborIdAdd));};
+        // replace the neighbor list wholesale, channels are left to the caller (see bindLinks)
+        void                               setNeighbors          (vector<interfaceId> neighbors)            {retireTraffic(); _neighbors = std::move(neighbors); _links.assign(_neighbors.size(), Link());};
         void                               removeNeighbor        (interfaceId neighborIdToRemove);
 
-        // moves msgs from the channel to the inStream if msg delay is 0 else decrease msg delay by 1
-        void                               receive               ();
+        // moves msgs from the channel to the inStream if msg delay is 0 else decrease msg delay by 1,
+        // noting in depths, if given, what is left on each channel and the inStream's length
+        void                               receive               (QueueDepths *depths = nullptr);
        
         // sends all messages in _outStream to there respective targets
         void                               transmit              ();
@@ -171,6 +250,15 @@ namespace quantas{
         friend ostream&                    operator<<            (ostream&, const NetworkInterface<messageType>&);
     };
 
+    template <class message>
+    vector<NetworkInterface<message>*> NetworkInterface<message>::_directory;
+
+    template <class message>
+    const DelayTable* NetworkInterface<message>::_delayTable = nullptr;
+
+    template <class message>
+    bool NetworkInterface<message>::_countingTraffic = false;
+
     template <class message>
     void NetworkInterface<message>::broadcast(message msg){
         for(auto it = _neighbors.begin(); it != _neighbors.end(); it++){
@@ -254,7 +342,7 @@ namespace quantas{
         _inStream = deque<Packet<message> >();
         _outStream = deque<Packet<message> >();
         _outBoundChannels = map<interfaceId, NetworkInterface<message>* >();
-        _outBoundChannelDelays = map<interfaceId,int>();
+        _outBoundChannelDelays = map<interfaceId,ChannelDelay>();
         _inBoundChannels = map<interfaceId,aChannel>();
         _log = &cout;
         _printNeighborhood = false;
@@ -266,7 +354,7 @@ namespace quantas{
         _inStream = deque<Packet<message> >();
         _outStream = deque<Packet<message> >();
         _outBoundChannels = map<interfaceId, NetworkInterface<message>* >();
-        _outBoundChannelDelays = map<interfaceId,int>();
+        _outBoundChannelDelays = map<interfaceId,ChannelDelay>();
         _inBoundChannels = map<interfaceId,aChannel>();
         _log = &cout;
         _printNeighborhood = false;
@@ -280,60 +368,196 @@ namespace quantas{
         _outBoundChannels = rhs._outBoundChannels;
         _inBoundChannels = rhs._inBoundChannels;
         _outBoundChannelDelays = rhs._outBoundChannelDelays;
+        _neighbors = rhs._neighbors;
+        _links = rhs._links;
+        _traffic = rhs._traffic;
+        _pastTraffic = rhs._pastTraffic;
         _log = rhs._log;
         _printNeighborhood = rhs._printNeighborhood;
     }
 
     template <class message>
-    void NetworkInterface<message>::addChannel(NetworkInterface<message> &newNeighbor, int delay){
+    void NetworkInterface<message>::addChannel(NetworkInterface<message> &newNeighbor, ChannelDelay delay){
         // guard to make sure delay is at lest 1, less then 1 will couse errors when calculating delay (divisioin by 0)
-        int edgeDelay = delay;
-        if(edgeDelay < 1){
-            edgeDelay = 1;
+        if(delay.maxDelay < 1){
+            delay.maxDelay = 1;
         }
-        _outBoundChannels[newNeighbor.id()] = &newNeighbor;
-        _outBoundChannelDelays[newNeighbor.id()] = edgeDelay;
-        _inBoundChannels[newNeighbor.id()] = deque<Packet<message> >();
+        // channels are usually opened in increasing id order, so hinting at the end keeps this linear
+        _outBoundChannels.insert_or_assign(_outBoundChannels.end(), newNeighbor.id(), &newNeighbor);
+        _outBoundChannelDelays.insert_or_assign(_outBoundChannelDelays.end(), newNeighbor.id(), delay);
+        // an open channel keeps the packets in flight on it
+        _inBoundChannels.try_emplace(_inBoundChannels.end(), newNeighbor.id());
     }
 
-    // called on recever
     template <class message>
-    void NetworkInterface<message>::send(Packet<message> outMessage){
-        _inBoundChannels.at(outMessage.sourceId()).push_back(outMessage);
+    typename NetworkInterface<message>::Link NetworkInterface<message>::linkTo(interfaceId neighborId){
+        Link link;
+        auto neighbor = _outBoundChannels.find(neighborId);
+        if (neighbor != _outBoundChannels.end()) {
+            link.channel = &neighbor->second->_inBoundChannels.at(_id);
+            link.delay = _outBoundChannelDelays.at(neighborId);
+        }
+        return link;
+    }
+
+    template <class message>
+    typename NetworkInterface<message>::Link NetworkInterface<message>::connect(interfaceId neighborId){
+        if (neighborId == _id || neighborId < 0 || neighborId >= (interfaceId)_directory.size() || _directory[neighborId] == nullptr) {
+            return Link();
+        }
+        NetworkInterface<message> &neighbor = *_directory[neighborId];
+        std::scoped_lock lock(_channelMutex, neighbor._channelMutex);
+        if (_outBoundChannels.count(neighborId) == 0) {
+            ChannelDelay delay = _delayTable == nullptr ? ChannelDelay() : _delayTable->channelDelay(_id, neighborId);
+            addChannel(neighbor, delay);
+            neighbor.addChannel(*this, delay);
+        }
+        return linkTo(neighborId);
     }
 
-    // called on sender
+    template <class message>
+    void NetworkInterface<message>::serializeChannels(Checkpoint &archive){
+        archive & _neighbors & _traffic & _pastTraffic;
+        serializeQueue(archive, _inStream);
+        serializeQueue(archive, _outStream);
+        vector<interfaceId> partners = channels();
+        archive & partners;
+        if (archive.restoring()) {
+            _outBoundChannels.clear();
+            _outBoundChannelDelays.clear();
+            _inBoundChannels.clear();
+            _links.assign(_neighbors.size(), Link());
+        }
+        for (interfaceId partner : partners) {
+            if (!archive.good()) {
+                return;
+            }
+            if (archive.restoring()) {
+                if (partner < 0 || partner >= (interfaceId)_directory.size() || _directory[partner] == nullptr) {
+                    archive.fail("the checkpoint has a channel to a missing peer");
+                    return;
+                }
+                addChannel(*_directory[partner], ChannelDelay());
+            }
+            archive & _outBoundChannelDelays.at(partner);
+            serializeQueue(archive, _inBoundChannels.at(partner));
+        }
+    }
+
+    template <class message>
+    void NetworkInterface<message>::serializeQueue(Checkpoint &archive, aChannel &queue){
+        size_t count = checkpointSize(archive, queue.size());
+        if (archive.restoring()) {
+            queue.assign(count, Packet<message>(NO_PEER_ID));
+        }
+        for (Packet<message> &packet : queue) {
+            archive & packet;
+        }
+    }
+
+    template <class message>
+    void NetworkInterface<message>::bindLinks(){
+        _links.resize(_neighbors.size());
+        for (size_t i = 0; i < _neighbors.size(); i++) {
+            _links[i] = linkTo(_neighbors[i]);
+        }
+    }
+
+    // called on sender. The channel of every packet is looked up first, so that the delays of the
+    // whole outStream can be drawn in one batch.
     template <class message>
     void NetworkInterface<message>::transmit(){
-        // send all messages to there destination peer channels  
-        while(!_outStream.empty()){
-			Packet<message> outMessage = _outStream.front();
-			_outStream.pop_front();
-			if (_id == outMessage.targetId()) {// if sent to self loop back next round
-				outMessage.setDelay(1);
-				_inStream.push_back(outMessage);
-			}
-			else if (!isNeighbor(outMessage.targetId()))// skip messages if they are not sent to a neighbor
-			{
-				continue;
-			}
-			else {
-				interfaceId targetId = outMessage.targetId();
-				int maxDelay = _outBoundChannelDelays.at(targetId);
-				outMessage.setDelay(maxDelay);
-				_outBoundChannels[targetId]->send(outMessage);
-			}
-		}
+        static thread_local vector<aChannel*>   targets;
+        static thread_local vector<int>         low, high, delays;
+        size_t count = _outStream.size();
+        targets.resize(count);
+        low.resize(count);
+        high.resize(count);
+        delays.resize(count);
+        bool counting = _countingTraffic;
+        if (counting && _traffic.size() < _neighbors.size()) {
+            _traffic.resize(_neighbors.size());
+        }
+        for (size_t i = 0; i < count; i++) {
+            interfaceId targetId = _outStream[i].targetId();
+            targets[i] = nullptr;
+            low[i] = high[i] = 1;
+            if (_id == targetId) {// if sent to self loop back next round
+                targets[i] = &_inStream;
+                continue;
+            }
+            auto neighbor = find(_neighbors.begin(), _neighbors.end(), targetId);
+            if (neighbor == _neighbors.end()) {// skip messages if they are not sent to a neighbor
+                continue;
+            }
+            const Link &link = _links[neighbor - _neighbors.begin()];
+            if (link.channel != nullptr) {
+                int minDelay = _delayTable == nullptr ? 1 : (*_delayTable)[link.delay.distribution].minDelay();
+                targets[i] = link.channel;
+                high[i] = link.delay.maxDelay;
+                low[i] = std::max(1, std::min(minDelay, high[i]));
+                if (counting) {
+                    LinkTraffic &traffic = _traffic[neighbor - _neighbors.begin()];
+                    traffic.messages++;
+                    traffic.bytes += sizeof(message);
+                }
+            }
+        }
+        Distribution::getUniformDelays(low.data(), high.data(), delays.data(), count);
+
+        if (Tracer::enabled()) {
+            int round = LogWriter::instance()->getRound();
+            for (size_t i = 0; i < count; i++) {
+                const Packet<message> &packet = _outStream[i];
+                Tracer::trace(targets[i] != nullptr ? Tracer::SEND : Tracer::DROP, round, _id, packet.targetId(), targets[i] != nullptr ? delays[i] : 0, sizeof(message), traceType(packet.body()));
+            }
+        }
+
+        // send all messages to there destination peer channels
+        for (size_t i = 0; i < count; i++) {
+            if (targets[i] != nullptr) {
+                QUANTAS_PROBE4(packet__send, LogWriter::instance()->getRound(), _id, _outStream.front().targetId(), delays[i]);
+                _outStream.front().setFixedDelay(delays[i]);
+                targets[i]->push_back(std::move(_outStream.front()));
+            }
+            else {
+                QUANTAS_PROBE3(packet__drop, LogWriter::instance()->getRound(), _id, _outStream.front().targetId());
+            }
+            _outStream.pop_front();
+        }
     }
 
     template <class message>
-    void NetworkInterface<message>::receive() {
-        for (int i = 0; i != _inBoundChannels.size(); ++i) {
-            while(!_inBoundChannels[i].empty() && _inBoundChannels[i].front().hasArrived()){
-                _inStream.push_back(_inBoundChannels[i].front());
-                _inBoundChannels[i].pop_front();
+    void NetworkInterface<message>::receive(QueueDepths *depths) {
+        bool tracing = Tracer::enabled();
+        bool timing = DeliveryLatency::enabled();
+        int round = LogWriter::instance()->getRound();
+        for (auto it = _inBoundChannels.begin(); it != _inBoundChannels.end(); ++it) {
+            aChannel &channel = it->second;
+            int channelClass = -1;
+            while(!channel.empty() && channel.front().hasArrived()){
+                QUANTAS_PROBE4(packet__deliver, LogWriter::instance()->getRound(), channel.front().sourceId(), _id, channel.front().getDelay());
+                if (tracing) {
+                    const Packet<message> &packet = channel.front();
+                    Tracer::trace(Tracer::RECEIVE, LogWriter::instance()->getRound(), packet.sourceId(), _id, packet.getDelay(), sizeof(message), traceType(packet.body()));
+                }
+                if (timing) {
+                    if (channelClass < 0) {
+                        channelClass = classFrom(it->first);
+                    }
+                    const Packet<message> &packet = channel.front();
+                    DeliveryLatency::delivered(round, channelClass, packet.getRound(), packet.getDelay(), packet.body());
+                }
+                _inStream.push_back(channel.front());
+                channel.pop_front();
+            }
+            if (depths != nullptr) {
+                depths->channel(channel.size());
             }
         }
+        if (depths != nullptr) {
+            depths->stream(_inStream.size());
+        }
     }
 
 
@@ -354,9 +578,22 @@ namespace quantas{
         return channelsToPeersByIds;
     }
 
+    // the packets, and each channel's entries in the three channel maps, a tree node having a color
+    // and three pointers besides its value
+    template <class message>
+    size_t NetworkInterface<message>::channelBytes()const{
+        size_t packets = 0;
+        for (auto it = _inBoundChannels.begin(); it != _inBoundChannels.end(); ++it) {
+            packets += it->second.size();
+        }
+        size_t entries = sizeof(typename map<interfaceId, aChannel>::value_type) + sizeof(typename map<interfaceId, ChannelDelay>::value_type)
+            + sizeof(typename map<interfaceId, NetworkInterface<message>*>::value_type) + 3 * 4 * sizeof(void*);
+        return packets * sizeof(Packet<message>) + _inBoundChannels.size() * entries;
+    }
+
     template <class message>
     int NetworkInterface<message>::getDelayToNeighbor(interfaceId id)const{
-        return _outBoundChannelDelays.at(id);
+        return _outBoundChannelDelays.at(id).maxDelay;
     }
 
     template <class message>
@@ -378,7 +615,59 @@ namespace quantas{
 
     template <class message>
     void NetworkInterface<message>::removeNeighbor(interfaceId neighborIdToRemove){
-        _neighbors.erase(std::remove(_neighbors.begin(), _neighbors.end(), neighborIdToRemove), _neighbors.end());
+        size_t kept = 0;
+        size_t counted = _traffic.size();
+        for (size_t i = 0; i < _neighbors.size(); i++) {
+            if (_neighbors[i] != neighborIdToRemove) {
+                _neighbors[kept] = _neighbors[i];
+                _links[kept] = _links[i];
+                if (i < counted) {
+                    _traffic[kept] = _traffic[i];
+                }
+                ++kept;
+            }
+            else if (i < counted && _traffic[i].messages > 0) {
+                _pastTraffic[_neighbors[i]] += _traffic[i];
+            }
+        }
+        _neighbors.resize(kept);
+        _links.resize(kept);
+        _traffic.resize(std::min(kept, counted));
+    }
+
+    // the other end's channel delays are only changed between the phases of a round
+    template <class message>
+    int NetworkInterface<message>::classFrom(interfaceId senderId)const{
+        if (senderId < 0 || senderId >= (interfaceId)_directory.size() || _directory[senderId] == nullptr) {
+            return 0;
+        }
+        const map<interfaceId, ChannelDelay> &delays = _directory[senderId]->_outBoundChannelDelays;
+        auto delay = delays.find(_id);
+        return delay == delays.end() ? 0 : delay->second.distribution;
+    }
+
+    template <class message>
+    void NetworkInterface<message>::retireTraffic(){
+        for (size_t i = 0; i < _traffic.size(); i++) {
+            if (_traffic[i].messages > 0) {
+                _pastTraffic[_neighbors[i]] += _traffic[i];
+            }
+        }
+        _traffic.clear();
+    }
+
+    template <class message>
+    template<class F>
+    void NetworkInterface<message>::forEachTraffic(F&& edge)const{
+        map<interfaceId, LinkTraffic> traffic = _pastTraffic;
+        for (size_t i = 0; i < _traffic.size(); i++) {
+            if (_traffic[i].messages > 0) {
+                traffic[_neighbors[i]] += _traffic[i];
+            }
+        }
+        for (const auto &target : traffic) {
+            edge(target.first, target.second);
+        }
     }
 
     template <class message>
@@ -391,6 +680,10 @@ namespace quantas{
         _outBoundChannels = rhs._outBoundChannels;
         _inBoundChannels = rhs._inBoundChannels;
         _outBoundChannelDelays = rhs._outBoundChannelDelays;
+        _neighbors = rhs._neighbors;
+        _links = rhs._links;
+        _traffic = rhs._traffic;
+        _pastTraffic = rhs._pastTraffic;
         _log = rhs._log;
         _printNeighborhood = rhs._printNeighborhood;
 
@@ -26,6 +26,7 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <random>
 #include "LogWriter.hpp"
 #include "Distribution.hpp"
+#include "Checkpoint.hpp"
 
 namespace quantas{
     
@@ -63,6 +64,8 @@ namespace quantas{
         void        setSource       (long s){_sourceId = s;};
         void        setTarget       (long t){_targetId = t;};
         void        setDelay        (int delayMax, int delayMin = 1);
+        // sets the delay to one already drawn, e.g. in a batch
+        void        setFixedDelay   (int delay){_delay = delay;};
         void        setMessage      (const message c){_body = c;};
         
         // getters
@@ -71,6 +74,8 @@ namespace quantas{
         long        sourceId        ()const {return _sourceId;};
         bool        hasArrived      ()const {return LogWriter::instance()->getRound() >= _round + _delay;};
         message     getMessage      ()const {return _body;};
+        // the message without copying it
+        const message& body         ()const {return _body;};
         int         getDelay        ()const {return _delay;};
         int         getRound        ()const {return _round;};
         
@@ -79,6 +84,9 @@ namespace quantas{
         
         //void
         
+        // saves or restores the packet, its message needs to be checkpointable
+        void        serialize       (Checkpoint &archive)       {archive & _id & _targetId & _sourceId & _delay & _round & _body;};
+
         Packet&     operator=       (const Packet<message> &rhs);
         bool        operator==      (const Packet<message> &rhs) const;
         bool        operator!=      (const Packet<message> &rhs) const;
@@ -29,6 +29,7 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <algorithm>
 #include "NetworkInterface.hpp"
 #include "LogWriter.hpp"
+#include "Metrics.hpp"
 
 namespace quantas{
 
@@ -52,12 +53,21 @@ namespace quantas{
         virtual ~Peer                                              () = 0;
         // initialize any user defined parameters
         virtual void                       initParameters          (const vector<Peer<message>*>& _peers, json parameters) {};
+        // change user defined parameters in the middle of a run, used by branched runs
+        virtual void                       updateParameters        (const vector<Peer<message>*>& _peers, json parameters) {};
         // perform one step of the Algorithm with the messages in inStream
         virtual void                       performComputation      () = 0;
         // ran once per round, used to submit transactions or collect metrics
         virtual void                       endOfRound              (const vector<Peer<message>*>& _peers) {};
+        // saves or restores the algorithm's state for a checkpoint (see Checkpoint.hpp), peers that
+        // support checkpoints override it, including any static state they keep
+        virtual void                       serialize               (Checkpoint &archive)                  { archive.fail("this peer does not support checkpoints"); };
+        // bytes held by the algorithm's state, for the accounting of memory (see MemoryAccounting.hpp),
+        // peers whose state grows override it with an estimate
+        virtual size_t                     stateBytes              ()const                                { return 0; };
         static int                         getRound                ()                                     { return _round; };
         static void                        initializeRound         ()                                     { _round = 0; };
+        static void                        setRound                (int round)                            { _round = round; };
         static void                        incrementRound          ()                                     { _round++; };
         static void                        initializeLastRound     (int lastRound)                        { _lastRound = lastRound; };
         static bool                        lastRound               ()                                     { return _lastRound == _round; };
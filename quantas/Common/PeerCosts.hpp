@@ -0,0 +1,153 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class accounts what each peer costs over a test, when an experiment asks for it with
+// "costs": {"top": 10, "file": "costs.csv"}: the time spent in its performComputation, the
+// packets it received and sent, and the most packets waiting in its inStream at once. The network
+// adds to a peer's entry from the thread that runs the peer, so the entries need no locking.
+//
+// At the end of each test the top peers by each cost go into the log as "hotspots", and every
+// peer's costs are written to the csv file, if one is given, one line per peer and test.
+//
+// Packets received are those that reached the inStream since the end of the previous round's
+// performComputation, so packets a peer sends itself count too. Packets sent are those in the
+// outStream at transmit, including those dropped for not going to a neighbor.
+
+#ifndef PeerCosts_hpp
+#define PeerCosts_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include "Json.hpp"
+#include "Checkpoint.hpp"
+#include "FileName.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class PeerCosts {
+    public:
+        // costs is the experiment's "costs", accounting is off without it
+        void                    configure       (const json &costs);
+        bool                    enabled         ()const                 {return _enabled;};
+        // clears the costs, for a test of peers peers
+        void                    reset           (size_t peers);
+
+        // called after peer i's receive with the size of its inStream
+        void                    received        (size_t i, size_t inStream)                 {_in[i] += inStream - std::min(inStream, _left[i]); _inMax[i] = std::max<uint64_t>(_inMax[i], inStream);};
+        // called after peer i's performComputation, which took nanoseconds, with what is left in its inStream
+        void                    computed        (size_t i, int64_t nanoseconds, size_t inStream) {_compute[i] += nanoseconds; _left[i] = inStream;};
+        // called before peer i's transmit with the size of its outStream
+        void                    transmitted     (size_t i, size_t outStream)                {_out[i] += outStream;};
+
+        // logs the hotspots of test and writes the csv, ids being the peers' ids. suffix is added
+        // to the csv file's name, before its extension
+        json                    report          (int test, const vector<long> &ids, const string &suffix = "");
+        // saves or restores the costs of the test so far
+        void                    serialize       (Checkpoint &archive);
+
+    private:
+        bool                    _enabled = false;
+        size_t                  _top = 10;
+        string                  _file;
+        // the file written last, a new one is started rather than added to
+        string                  _written;
+        vector<int64_t>         _compute;
+        vector<uint64_t>        _in;
+        vector<uint64_t>        _out;
+        vector<uint64_t>        _inMax;
+        vector<uint64_t>        _left;
+
+        template<class T>
+        json                    top             (const vector<T> &costs, const vector<long> &ids, double scale)const;
+    };
+
+    inline void PeerCosts::configure(const json &costs) {
+        _enabled = costs.is_object() || (costs.is_boolean() && costs.get<bool>());
+        _top = costs.is_object() ? costs.value("top", 10) : 10;
+        _file = costs.is_object() ? costs.value("file", string()) : string();
+    }
+
+    inline void PeerCosts::reset(size_t peers) {
+        if (!_enabled) {
+            return;
+        }
+        _compute.assign(peers, 0);
+        _in.assign(peers, 0);
+        _out.assign(peers, 0);
+        _inMax.assign(peers, 0);
+        _left.assign(peers, 0);
+    }
+
+    inline void PeerCosts::serialize(Checkpoint &archive) {
+        bool enabled = _enabled;
+        archive & enabled;
+        if (enabled != _enabled) {
+            archive.fail("the checkpoint was taken with other \"costs\" settings");
+            return;
+        }
+        archive & _compute & _in & _out & _inMax & _left;
+    }
+
+    // the peers with the largest costs, largest first and by id among equals
+    template<class T>
+    json PeerCosts::top(const vector<T> &costs, const vector<long> &ids, double scale)const {
+        vector<size_t> order(costs.size());
+        std::iota(order.begin(), order.end(), 0);
+        size_t count = std::min(_top, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](size_t a, size_t b) {
+            return costs[a] != costs[b] ? costs[a] > costs[b] : ids[a] < ids[b];
+        });
+        json list = json::array();
+        for (size_t k = 0; k < count; k++) {
+            json value = scale == 1 ? json(costs[order[k]]) : json(costs[order[k]] * scale);
+            list.push_back({{"peer", ids[order[k]]}, {"value", value}});
+        }
+        return list;
+    }
+
+    inline json PeerCosts::report(int test, const vector<long> &ids, const string &suffix) {
+        json hotspots;
+        if (!_enabled) {
+            return hotspots;
+        }
+        hotspots["computeMs"] = top(_compute, ids, 1e-6);
+        hotspots["packetsIn"] = top(_in, ids, 1);
+        hotspots["packetsOut"] = top(_out, ids, 1);
+        hotspots["inStreamMax"] = top(_inMax, ids, 1);
+
+        if (!_file.empty()) {
+            string file = withSuffix(_file, suffix);
+            bool started = file == _written;
+            std::ofstream out(file, started ? std::ios::app : std::ios::trunc);
+            if (out.fail()) {
+                std::cerr << "Error: cannot open costs file " << file << std::endl;
+                return hotspots;
+            }
+            if (!started) {
+                out << "test,peer,computeMs,packetsIn,packetsOut,inStreamMax\n";
+                _written = file;
+            }
+            for (size_t i = 0; i < ids.size() && i < _compute.size(); i++) {
+                out << test << "," << ids[i] << "," << _compute[i] * 1e-6 << "," << _in[i] << "," << _out[i] << "," << _inMax[i] << "\n";
+            }
+        }
+        return hotspots;
+    }
+}
+
+#endif /* PeerCosts_hpp */
@@ -0,0 +1,324 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class counts hardware and software events per phase of the round loop with Linux's
+// perf_event_open, when an experiment asks for it with "perfCounters": true. Each thread that runs
+// a phase opens one group of counters for itself, the first time it does, and reads the group
+// before and after each of its blocks, adding the difference to the phase. At the end of a test
+// the counts of all threads are added up and go into the test's log as "perfCounters":
+//
+//     {"receive": {"cycles", "instructions", "ipc", "cacheMisses", "cacheMissRate", ...}, ...}
+//
+// Events the machine or the permissions (kernel.perf_event_paranoid) do not allow are left out
+// and listed under "unavailable", as hardware counters are in most virtual machines; if no event
+// can be counted, the log says so under "error" and the run goes on uncounted. Counts are scaled
+// up when the kernel had to share the counters with other groups.
+
+#ifndef PerfCounters_hpp
+#define PerfCounters_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "Json.hpp"
+#include "Profiler.hpp"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class PerfCounters {
+    public:
+        typedef RoundProfiler::Phase Phase;
+        enum EventId { CYCLES, INSTRUCTIONS, CACHE_REFERENCES, CACHE_MISSES, BRANCHES, BRANCH_MISSES, TASK_CLOCK, PAGE_FAULTS, CONTEXT_SWITCHES, EVENTS };
+
+        // perfCounters is the experiment's "perfCounters"
+        PerfCounters                            (const json &perfCounters);
+        ~PerfCounters                           ();
+
+        bool                    enabled         ()const                 {return _enabled;};
+        // loop, counted as part of phase on the thread that runs each block
+        template<class F>
+        auto                    counted         (Phase phase, F loop);
+        // count a phase run on the calling thread
+        void                    start           ();
+        void                    stop            (Phase phase);
+        // the threads were replaced (in a forked branch), those that count from now on open new groups
+        void                    resetThreads    ();
+        // clears the counts, for a new test
+        void                    reset           ();
+        // the counts of the test
+        json                    report          ();
+
+        static const char*      name            (EventId event);
+
+    private:
+        // the counters of one thread
+        struct Group {
+            int                 leader = -1;
+            vector<int>         fds;
+            vector<int>         events;         // the event each value read is
+            vector<uint64_t>    startValues;
+            uint64_t            startEnabled = 0;
+            uint64_t            startRunning = 0;
+            uint64_t            totals[RoundProfiler::PHASES][EVENTS] = {};
+            bool                open            (string &error);
+            void                close           ();
+            bool                read            (vector<uint64_t> &values, uint64_t &enabled, uint64_t &running);
+        };
+
+        bool                    _enabled;
+        string                  _error;
+        std::mutex              _mutex;
+        vector<std::unique_ptr<Group>> _groups;
+        uint64_t                _generation;
+
+        static std::atomic<uint64_t>& generations ()                    {static std::atomic<uint64_t> next {0}; return next;};
+        // the calling thread's group, nullptr if it has no counters
+        Group*                  local           ();
+        void                    begin           (Group &group);
+        void                    end             (Group &group, Phase phase);
+    };
+
+    inline PerfCounters::PerfCounters(const json &perfCounters) {
+        _enabled = perfCounters.is_boolean() && perfCounters.get<bool>();
+        _generation = ++generations();
+#ifndef __linux__
+        _error = "perf_event_open needs Linux";
+#endif
+    }
+
+    inline PerfCounters::~PerfCounters() {
+        for (auto &group : _groups) {
+            group->close();
+        }
+    }
+
+    inline const char* PerfCounters::name(EventId event) {
+        static const char* names[EVENTS] = {"cycles", "instructions", "cacheReferences", "cacheMisses", "branches", "branchMisses", "taskClockNs", "pageFaults", "contextSwitches"};
+        return names[event];
+    }
+
+    inline bool PerfCounters::Group::open(string &error) {
+#ifdef __linux__
+        static const uint32_t types[EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE, PERF_TYPE_SOFTWARE, PERF_TYPE_SOFTWARE};
+        static const uint64_t configs[EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_SW_PAGE_FAULTS, PERF_COUNT_SW_CONTEXT_SWITCHES};
+        for (int e = 0; e < EVENTS; e++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[e];
+            attr.config = configs[e];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.disabled = leader < 0; // the group starts when its leader is enabled
+            // the calling thread, on any cpu
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                if (error.empty()) {
+                    error = string(name(EventId(e))) + ": " + strerror(errno);
+                }
+                continue;
+            }
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds.push_back(fd);
+            events.push_back(e);
+        }
+        if (leader < 0) {
+            return false;
+        }
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    inline void PerfCounters::Group::close() {
+#ifdef __linux__
+        for (int fd : fds) {
+            ::close(fd);
+        }
+#endif
+        fds.clear();
+        leader = -1;
+    }
+
+    inline bool PerfCounters::Group::read(vector<uint64_t> &values, uint64_t &enabled, uint64_t &running) {
+#ifdef __linux__
+        // number of values, time enabled, time running, then the values in the order they were opened
+        uint64_t buffer[3 + EVENTS];
+        ssize_t size = ::read(leader, buffer, sizeof(buffer));
+        if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || buffer[0] != events.size()) {
+            return false;
+        }
+        enabled = buffer[1];
+        running = buffer[2];
+        values.assign(buffer + 3, buffer + 3 + events.size());
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    inline PerfCounters::Group* PerfCounters::local() {
+        thread_local uint64_t generation = 0;
+        thread_local Group *group = nullptr;
+        if (generation != _generation) {
+            generation = _generation;
+            std::unique_ptr<Group> opened(new Group());
+            string error;
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (opened->open(error)) {
+                group = opened.get();
+                _groups.push_back(std::move(opened));
+            }
+            else {
+                group = nullptr;
+            }
+            if (_error.empty()) {
+                _error = error;
+            }
+        }
+        return group;
+    }
+
+    inline void PerfCounters::begin(Group &group) {
+        if (!group.read(group.startValues, group.startEnabled, group.startRunning)) {
+            group.startValues.clear();
+        }
+    }
+
+    inline void PerfCounters::end(Group &group, Phase phase) {
+        vector<uint64_t> values;
+        uint64_t enabled, running;
+        if (group.startValues.empty() || !group.read(values, enabled, running)) {
+            return;
+        }
+        // while the counters were shared they only ran part of the time
+        double scale = running > group.startRunning && enabled > running ? double(enabled - group.startEnabled) / (running - group.startRunning) : 1;
+        for (size_t v = 0; v < values.size(); v++) {
+            group.totals[phase][group.events[v]] += static_cast<uint64_t>((values[v] - group.startValues[v]) * scale);
+        }
+    }
+
+    template<class F>
+    auto PerfCounters::counted(Phase phase, F loop) {
+        return [this, phase, loop](int a, int b) {
+            Group *group = _enabled ? local() : nullptr;
+            if (group == nullptr) {
+                loop(a, b);
+                return;
+            }
+            begin(*group);
+            loop(a, b);
+            end(*group, phase);
+        };
+    }
+
+    inline void PerfCounters::start() {
+        Group *group = _enabled ? local() : nullptr;
+        if (group != nullptr) {
+            begin(*group);
+        }
+    }
+
+    inline void PerfCounters::stop(Phase phase) {
+        Group *group = _enabled ? local() : nullptr;
+        if (group != nullptr) {
+            end(*group, phase);
+        }
+    }
+
+    // the groups of the parent's threads count those threads, not the child's; their totals stay
+    inline void PerfCounters::resetThreads() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &group : _groups) {
+            group->close();
+        }
+        _generation = ++generations();
+    }
+
+    inline void PerfCounters::reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &group : _groups) {
+            memset(group->totals, 0, sizeof(group->totals));
+        }
+    }
+
+    inline json PerfCounters::report() {
+        json counters;
+        if (!_enabled) {
+            return counters;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_groups.empty()) {
+            counters["error"] = _error.empty() ? string("no counters") : _error;
+            return counters;
+        }
+        bool counted[EVENTS] = {};
+        for (auto &group : _groups) {
+            for (int e : group->events) {
+                counted[e] = true;
+            }
+        }
+        for (int p = 0; p < RoundProfiler::PHASES; p++) {
+            uint64_t totals[EVENTS] = {};
+            for (auto &group : _groups) {
+                for (int e = 0; e < EVENTS; e++) {
+                    totals[e] += group->totals[p][e];
+                }
+            }
+            json &phase = counters[RoundProfiler::name(Phase(p))];
+            for (int e = 0; e < EVENTS; e++) {
+                if (counted[e]) {
+                    phase[name(EventId(e))] = totals[e];
+                }
+            }
+            if (counted[CYCLES] && counted[INSTRUCTIONS]) {
+                phase["ipc"] = totals[CYCLES] ? double(totals[INSTRUCTIONS]) / totals[CYCLES] : 0;
+            }
+            if (counted[CACHE_REFERENCES] && counted[CACHE_MISSES]) {
+                phase["cacheMissRate"] = totals[CACHE_REFERENCES] ? double(totals[CACHE_MISSES]) / totals[CACHE_REFERENCES] : 0;
+            }
+            if (counted[BRANCHES] && counted[BRANCH_MISSES]) {
+                phase["branchMissRate"] = totals[BRANCHES] ? double(totals[BRANCH_MISSES]) / totals[BRANCHES] : 0;
+            }
+        }
+        json unavailable = json::array();
+        for (int e = 0; e < EVENTS; e++) {
+            if (!counted[e]) {
+                unavailable.push_back(name(EventId(e)));
+            }
+        }
+        if (!unavailable.empty()) {
+            counters["unavailable"] = unavailable;
+            counters["error"] = _error;
+        }
+        return counters;
+    }
+}
+
+#endif /* PerfCounters_hpp */
@@ -0,0 +1,50 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Static tracepoints (USDT) of provider "quantas" for perf, bpftrace and systemtap. They are
+// compiled in with -DQUANTAS_PROBES (make release PROBES=1) where <sys/sdt.h> is installed
+// (systemtap-sdt-dev), and are otherwise empty. A probe compiled in is a nop until a tracer
+// attaches to it, and its notes survive the stripping of release builds.
+//
+//   test__start(test)                      test__end(test)
+//   round__start(test, round)              round__end(test, round)
+//   phase__end(test, round, phase)         phase as RoundProfiler::Phase: 0 topology, 1 receive,
+//                                          2 performComputation, 3 endOfRound, 4 transmit
+//   packet__send(round, source, target, delay)
+//   packet__drop(round, source, target)    sent to a peer that is not a neighbor
+//   packet__deliver(round, source, target, delay)
+//
+// e.g. bpftrace -e 'usdt:./quantas.exe:quantas:phase__end { @[arg2] = count(); }'
+
+#ifndef Probes_hpp
+#define Probes_hpp
+
+#if defined(QUANTAS_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define QUANTAS_HAS_PROBES 1
+#endif
+#endif
+
+#ifdef QUANTAS_HAS_PROBES
+#define QUANTAS_PROBE1(name, a)             DTRACE_PROBE1(quantas, name, a)
+#define QUANTAS_PROBE2(name, a, b)          DTRACE_PROBE2(quantas, name, a, b)
+#define QUANTAS_PROBE3(name, a, b, c)       DTRACE_PROBE3(quantas, name, a, b, c)
+#define QUANTAS_PROBE4(name, a, b, c, d)    DTRACE_PROBE4(quantas, name, a, b, c, d)
+#else
+#if defined(QUANTAS_PROBES)
+#warning "QUANTAS_PROBES is set but <sys/sdt.h> was not found, the probes are left out"
+#endif
+#define QUANTAS_PROBE1(name, a)             do {} while (0)
+#define QUANTAS_PROBE2(name, a, b)          do {} while (0)
+#define QUANTAS_PROBE3(name, a, b, c)       do {} while (0)
+#define QUANTAS_PROBE4(name, a, b, c, d)    do {} while (0)
+#endif
+
+#endif /* Probes_hpp */
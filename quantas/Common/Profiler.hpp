@@ -0,0 +1,261 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class times the phases of the simulation's round loop when an experiment asks for it with
+// "profile": true. Every round the wall-clock time of each phase is kept in a histogram, and in
+// the phases run on the thread pool each thread's busy time, the time it spent running blocks of
+// the loop, is added up. The rest of the phase the thread spent waiting at the barrier, for
+// other threads' blocks to finish. The summary, in milliseconds, goes into the log as "profile":
+//
+//     "phases": {"receive": {"total", "mean", "p50", "p90", "p99", "max", "imbalance"}, ...}
+//     "threads": [{"busy": {"receive": ...}, "wait": {...}}, ...]
+//     "setup": {"total", "mean", "max"}
+//
+// where imbalance is the mean over rounds of the busiest thread's time over the mean thread's, and
+// setup is the time spent building the network of each test, before its first round.
+// With "profile": {"series": true} the time of each phase is also recorded every round, as
+// profile.<phase>, through LogWriter::record. Without "profile" no clock is read.
+
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include "Json.hpp"
+#include "LogWriter.hpp"
+#include "Metrics.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class RoundProfiler {
+    public:
+        enum Phase { TOPOLOGY, RECEIVE, COMPUTE, END_OF_ROUND, TRANSMIT, PHASES };
+
+        // profile is the experiment's "profile", threads the size of the pool
+        RoundProfiler                           (const json &profile, int threads);
+
+        bool                    enabled         ()const                 {return _enabled;};
+        void                    startRound      ();
+        // times the setup of a test, from startSetup to endSetup
+        void                    startSetup      ()                      {startRound();};
+        void                    endSetup        ();
+        // ends phase, which started when the previous one ended
+        void                    endPhase        (Phase phase);
+        // loop, timed as part of phase on the thread that runs each block
+        template<class F>
+        auto                    timed           (Phase phase, F loop);
+        // the pool's threads were replaced, those that run blocks from now on are numbered anew
+        void                    resetThreads    ();
+        json                    summary         ()const;
+
+        static const char*      name            (Phase phase);
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        // nanoseconds in the log-linear buckets of Metrics
+        struct Durations {
+            vector<uint64_t>    buckets         = vector<uint64_t>(Metrics::BUCKETS);
+            uint64_t            count           = 0;
+            int64_t             sum             = 0;
+            int64_t             max             = 0;
+            void                add             (int64_t nanoseconds);
+            int64_t             percentile      (double fraction)const;
+        };
+        struct ThreadTimes {
+            std::atomic<int64_t> phase[PHASES]; // busy this round
+            int64_t             busy[PHASES];
+            int64_t             wait[PHASES];
+            ThreadTimes                         ();
+        };
+
+        bool                    _enabled;
+        bool                    _series;
+        clock::time_point       _mark;
+        Durations               _phases[PHASES];
+        Durations               _setup;
+        double                  _imbalance[PHASES] = {};
+        int                     _parallelRounds[PHASES] = {};
+        vector<std::unique_ptr<ThreadTimes>> _threads;
+        std::atomic<int>        _nextThread {0};
+        uint64_t                _generation;
+        int                     _threadsUsed = 0;
+
+        static bool             parallel        (Phase phase)           {return phase == RECEIVE || phase == COMPUTE || phase == TRANSMIT;};
+        static std::atomic<uint64_t>& generations ()                    {static std::atomic<uint64_t> next {0}; return next;};
+        ThreadTimes&            local           ();
+        static double           milliseconds    (double nanoseconds)    {return nanoseconds / 1e6;};
+    };
+
+    inline RoundProfiler::RoundProfiler(const json &profile, int threads) {
+        _enabled = profile.is_boolean() ? profile.get<bool>() : profile.is_object();
+        _series = profile.is_object() && profile.value("series", false);
+        _generation = ++generations();
+        // a thread pool replaced in a branch may number a few more threads; any beyond share the last
+        for (int i = 0; i < std::max(threads, 1) * 2; i++) {
+            _threads.emplace_back(new ThreadTimes());
+        }
+    }
+
+    inline RoundProfiler::ThreadTimes::ThreadTimes() {
+        for (int p = 0; p < PHASES; p++) {
+            phase[p].store(0);
+            busy[p] = 0;
+            wait[p] = 0;
+        }
+    }
+
+    inline const char* RoundProfiler::name(Phase phase) {
+        static const char* names[PHASES] = {"topology", "receive", "performComputation", "endOfRound", "transmit"};
+        return names[phase];
+    }
+
+    inline void RoundProfiler::resetThreads() {
+        _generation = ++generations();
+        _nextThread = 0;
+    }
+
+    inline RoundProfiler::ThreadTimes& RoundProfiler::local() {
+        thread_local uint64_t generation = 0;
+        thread_local int index = 0;
+        if (generation != _generation) {
+            generation = _generation;
+            index = std::min<int>(_nextThread++, _threads.size() - 1);
+        }
+        return *_threads[index];
+    }
+
+    template<class F>
+    auto RoundProfiler::timed(Phase phase, F loop) {
+        return [this, phase, loop](int a, int b) {
+            if (!_enabled) {
+                loop(a, b);
+                return;
+            }
+            clock::time_point start = clock::now();
+            loop(a, b);
+            // once per block, and threads beyond the slots share the last one, so a real add
+            local().phase[phase].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count(), std::memory_order_relaxed);
+        };
+    }
+
+    inline void RoundProfiler::startRound() {
+        if (_enabled) {
+            _mark = clock::now();
+        }
+    }
+
+    inline void RoundProfiler::endSetup() {
+        if (_enabled) {
+            _setup.add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _mark).count());
+        }
+    }
+
+    // the pool's futures have been waited for, so the threads' times of the phase are complete
+    inline void RoundProfiler::endPhase(Phase phase) {
+        if (!_enabled) {
+            return;
+        }
+        clock::time_point now = clock::now();
+        int64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _mark).count();
+        _mark = now;
+        _phases[phase].add(wall);
+        if (_series) {
+            LogWriter::instance()->record(string("profile.") + name(phase), milliseconds(wall));
+        }
+        if (!parallel(phase)) {
+            return;
+        }
+        int used = std::min<int>(_nextThread, _threads.size());
+        _threadsUsed = std::max(_threadsUsed, used);
+        int64_t most = 0;
+        int64_t total = 0;
+        for (int t = 0; t < used; t++) {
+            ThreadTimes &times = *_threads[t];
+            int64_t busy = times.phase[phase].exchange(0, std::memory_order_relaxed);
+            times.busy[phase] += busy;
+            times.wait[phase] += std::max<int64_t>(wall - busy, 0);
+            most = std::max(most, busy);
+            total += busy;
+        }
+        if (used > 0 && total > 0) {
+            _imbalance[phase] += most / (double(total) / used);
+            _parallelRounds[phase]++;
+        }
+    }
+
+    inline json RoundProfiler::summary()const {
+        json profile;
+        profile["unit"] = "ms";
+        for (int p = 0; p < PHASES; p++) {
+            const Durations &durations = _phases[p];
+            json &phase = profile["phases"][name(Phase(p))];
+            phase["total"] = milliseconds(durations.sum);
+            phase["mean"] = durations.count ? milliseconds(double(durations.sum) / durations.count) : 0;
+            phase["p50"] = milliseconds(durations.percentile(0.5));
+            phase["p90"] = milliseconds(durations.percentile(0.9));
+            phase["p99"] = milliseconds(durations.percentile(0.99));
+            phase["max"] = milliseconds(durations.max);
+            if (parallel(Phase(p))) {
+                phase["imbalance"] = _parallelRounds[p] ? _imbalance[p] / _parallelRounds[p] : 1;
+            }
+        }
+        profile["setup"]["total"] = milliseconds(_setup.sum);
+        profile["setup"]["mean"] = _setup.count ? milliseconds(double(_setup.sum) / _setup.count) : 0;
+        profile["setup"]["max"] = milliseconds(_setup.max);
+        profile["threads"] = json::array();
+        for (int t = 0; t < _threadsUsed; t++) {
+            json thread;
+            for (int p = 0; p < PHASES; p++) {
+                if (parallel(Phase(p))) {
+                    thread["busy"][name(Phase(p))] = milliseconds(_threads[t]->busy[p]);
+                    thread["wait"][name(Phase(p))] = milliseconds(_threads[t]->wait[p]);
+                }
+            }
+            profile["threads"].push_back(thread);
+        }
+        return profile;
+    }
+
+    inline void RoundProfiler::Durations::add(int64_t nanoseconds) {
+        nanoseconds = std::max<int64_t>(nanoseconds, 0);
+        buckets[Metrics::bucket(nanoseconds)]++;
+        count++;
+        sum += nanoseconds;
+        max = std::max(max, nanoseconds);
+    }
+
+    // the middle of the bucket holding the value, as Histogram::percentile
+    inline int64_t RoundProfiler::Durations::percentile(double fraction)const {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * count)));
+        uint64_t seen = 0;
+        for (int b = 0; b < Metrics::BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen >= rank) {
+                return std::min<int64_t>(Metrics::bucketLow(b) + (Metrics::bucketWidth(b) - 1) / 2, max);
+            }
+        }
+        return max;
+    }
+}
+
+#endif /* Profiler_hpp */
@@ -0,0 +1,197 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class measures how congested the network is, when an experiment asks for it with
+//
+//     "queues": true
+//
+// The receive phase already visits every channel, so each interface's receive notes in a
+// QueueDepths, one per block of peers, the packets left on each of its inbound channels once the
+// arrived ones are taken off (those still in flight), and the length of its inStream, which is
+// what its performComputation starts with. The blocks are added up once each, and at the end of
+// the round recorded as the series queue.inFlight, queue.maxChannelDepth, queue.inStream and
+// queue.maxInStream. At the end of each test its log gets "queues": the round the most packets
+// were in flight, and the distributions over the test of the channels' depths and the inStreams'
+// lengths, in power of two buckets, bucket k > 0 counting the values in [2^(k-1), 2^k).
+
+#ifndef QueueTelemetry_hpp
+#define QueueTelemetry_hpp
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include "Json.hpp"
+#include "LogWriter.hpp"
+#include "Checkpoint.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using nlohmann::json;
+
+    // the depths noted by the interfaces of a block of peers in one round
+    struct QueueDepths {
+        static const int        BUCKETS         = 65;
+
+        uint64_t                inFlight = 0;
+        uint64_t                maxChannelDepth = 0;
+        uint64_t                inStream = 0;
+        uint64_t                maxInStream = 0;
+        uint64_t                channelBuckets[BUCKETS] = {};
+        uint64_t                inStreamBuckets[BUCKETS] = {};
+
+        // the power of two bucket of value, 0 holding 0
+        static int              bucket          (uint64_t value)        {return value == 0 ? 0 : 64 - __builtin_clzll(value);};
+        // packets left on a channel after receive
+        void                    channel         (uint64_t depth) {
+            inFlight += depth;
+            maxChannelDepth = std::max(maxChannelDepth, depth);
+            channelBuckets[bucket(depth)]++;
+        };
+        // an inStream after receive
+        void                    stream          (uint64_t length) {
+            inStream += length;
+            maxInStream = std::max(maxInStream, length);
+            inStreamBuckets[bucket(length)]++;
+        };
+    };
+
+    class QueueTelemetry {
+    public:
+        // queues is the experiment's "queues", telemetry is off without it
+        void                    configure       (const json &queues)    {_enabled = queues.is_object() || (queues.is_boolean() && queues.get<bool>());};
+        bool                    enabled         ()const                 {return _enabled;};
+        // clears the distributions, at the start of a test
+        void                    reset           ();
+        // called once per block with what its interfaces noted
+        void                    add             (const QueueDepths &depths);
+        // called once the round's peers have received, records the round's series
+        void                    endRound        (int round);
+        // the test's peak and distributions
+        json                    report          ()const;
+        // saves or restores the distributions of the test so far, between two rounds
+        void                    serialize       (Checkpoint &archive);
+
+    private:
+        bool                    _enabled = false;
+        std::atomic<uint64_t>   _inFlight {0};
+        std::atomic<uint64_t>   _maxChannelDepth {0};
+        std::atomic<uint64_t>   _inStream {0};
+        std::atomic<uint64_t>   _maxInStream {0};
+        std::atomic<uint64_t>   _channelBuckets[QueueDepths::BUCKETS];
+        std::atomic<uint64_t>   _inStreamBuckets[QueueDepths::BUCKETS];
+        uint64_t                _peakInFlight = 0;
+        int                     _peakRound = -1;
+
+        static void             raise           (std::atomic<uint64_t> &max, uint64_t value);
+        static json             distribution    (const std::atomic<uint64_t> *buckets);
+    };
+
+    inline void QueueTelemetry::reset() {
+        _inFlight.store(0);
+        _maxChannelDepth.store(0);
+        _inStream.store(0);
+        _maxInStream.store(0);
+        for (int b = 0; b < QueueDepths::BUCKETS; b++) {
+            _channelBuckets[b].store(0);
+            _inStreamBuckets[b].store(0);
+        }
+        _peakInFlight = 0;
+        _peakRound = -1;
+    }
+
+    inline void QueueTelemetry::raise(std::atomic<uint64_t> &max, uint64_t value) {
+        uint64_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    inline void QueueTelemetry::add(const QueueDepths &depths) {
+        _inFlight.fetch_add(depths.inFlight, std::memory_order_relaxed);
+        _inStream.fetch_add(depths.inStream, std::memory_order_relaxed);
+        raise(_maxChannelDepth, depths.maxChannelDepth);
+        raise(_maxInStream, depths.maxInStream);
+        for (int b = 0; b < QueueDepths::BUCKETS; b++) {
+            if (depths.channelBuckets[b] != 0) {
+                _channelBuckets[b].fetch_add(depths.channelBuckets[b], std::memory_order_relaxed);
+            }
+            if (depths.inStreamBuckets[b] != 0) {
+                _inStreamBuckets[b].fetch_add(depths.inStreamBuckets[b], std::memory_order_relaxed);
+            }
+        }
+    }
+
+    inline void QueueTelemetry::endRound(int round) {
+        if (!_enabled) {
+            return;
+        }
+        uint64_t inFlight = _inFlight.exchange(0);
+        LogWriter::instance()->record("queue.inFlight", double(inFlight));
+        LogWriter::instance()->record("queue.maxChannelDepth", double(_maxChannelDepth.exchange(0)));
+        LogWriter::instance()->record("queue.inStream", double(_inStream.exchange(0)));
+        LogWriter::instance()->record("queue.maxInStream", double(_maxInStream.exchange(0)));
+        if (inFlight > _peakInFlight || _peakRound < 0) {
+            _peakInFlight = inFlight;
+            _peakRound = round;
+        }
+    }
+
+    inline json QueueTelemetry::distribution(const std::atomic<uint64_t> *buckets) {
+        json summary;
+        uint64_t count = 0;
+        int last = 0;
+        for (int b = 0; b < QueueDepths::BUCKETS; b++) {
+            uint64_t n = buckets[b].load();
+            count += n;
+            if (n != 0) {
+                last = b;
+            }
+        }
+        summary["count"] = count;
+        summary["buckets"] = json::array();
+        for (int b = 0; b <= last && count > 0; b++) {
+            summary["buckets"].push_back(buckets[b].load());
+        }
+        return summary;
+    }
+
+    inline void QueueTelemetry::serialize(Checkpoint &archive) {
+        bool enabled = _enabled;
+        archive & enabled;
+        if (enabled != _enabled) {
+            archive.fail("the checkpoint was taken with other \"queues\" settings");
+            return;
+        }
+        uint64_t channelBuckets[QueueDepths::BUCKETS], inStreamBuckets[QueueDepths::BUCKETS];
+        for (int b = 0; b < QueueDepths::BUCKETS; b++) {
+            channelBuckets[b] = _channelBuckets[b].load();
+            inStreamBuckets[b] = _inStreamBuckets[b].load();
+        }
+        archive & channelBuckets & inStreamBuckets & _peakInFlight & _peakRound;
+        if (archive.restoring() && archive.good()) {
+            for (int b = 0; b < QueueDepths::BUCKETS; b++) {
+                _channelBuckets[b].store(channelBuckets[b]);
+                _inStreamBuckets[b].store(inStreamBuckets[b]);
+            }
+        }
+    }
+
+    inline json QueueTelemetry::report()const {
+        json queues;
+        if (!_enabled) {
+            return queues;
+        }
+        queues["peakInFlight"] = {{"round", _peakRound}, {"packets", _peakInFlight}};
+        queues["channelDepth"] = distribution(_channelBuckets);
+        queues["inStream"] = distribution(_inStreamBuckets);
+        return queues;
+    }
+}
+
+#endif /* QueueTelemetry_hpp */
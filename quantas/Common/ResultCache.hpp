@@ -0,0 +1,211 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class keeps the logs of finished experiments in a directory so they are not simulated
+// again. A log is stored under a hash of the experiment, with its keys in sorted order and
+// without its log file name, of the simulator executable and of the size and modification time
+// of the files the experiment reads (edge file, topology trace, delay histograms), so changing
+// the configuration, the algorithm's code or an input gives a new entry. A randomized experiment is reused as
+// the one sample that was run; giving it a key of its own, e.g. "seed": 2, asks for another.
+//
+// Experiments that write more than their log (branches, checkpoints, traces and reports written
+// to a "file" of their own, e.g. "metrics") are always run.
+
+#ifndef ResultCache_hpp
+#define ResultCache_hpp
+
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Json.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class ResultCache {
+    public:
+        // uses directory, creating it if needed
+        ResultCache                             (const string &directory);
+
+        // the name of experiment's entry
+        string                  key             (json experiment)const;
+        // reads the log stored under key, false if there is none
+        bool                    load            (const string &key, json &log)const;
+        void                    store           (const string &key, const json &log)const;
+
+        // true if all an experiment writes is its log
+        static bool             cacheable       (const json &experiment);
+        // reads and writes logs as LogWriter prints them
+        static bool             readLog         (const string &file, json &log);
+        static void             writeLog        (const string &file, const json &log);
+        // MurmurHash64A of size bytes
+        static uint64_t         hash            (const void *data, size_t size, uint64_t seed);
+
+    private:
+        string                  _directory;
+        // the hash of the running executable
+        string                  _build;
+
+        string                  path            (const string &key)const       {return _directory + "/" + key + ".json";};
+        static string           hex             (uint64_t value);
+        // the files experiment reads, each with its size and modification time
+        static string           inputs          (const json &experiment);
+    };
+
+    inline ResultCache::ResultCache(const string &directory) : _directory(directory) {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::cerr << "Error: cannot create cache directory " << directory << std::endl;
+        }
+        std::ifstream exe("/proc/self/exe", std::ios::binary);
+        std::stringstream bytes;
+        bytes << exe.rdbuf();
+        string image = bytes.str();
+        if (image.empty()) {
+            // without the executable, the time it was built identifies it
+            image = __DATE__ " " __TIME__;
+        }
+        _build = hex(hash(image.data(), image.size(), 0));
+    }
+
+    inline string ResultCache::key(json experiment)const {
+        experiment.erase("logFile");
+        // json objects keep their keys sorted, so equal experiments dump to the same text
+        string canonical = experiment.dump() + _build + inputs(experiment);
+        return hex(hash(canonical.data(), canonical.size(), 0)) + hex(hash(canonical.data(), canonical.size(), 0x9e3779b97f4a7c15ULL));
+    }
+
+    inline string ResultCache::inputs(const json &experiment) {
+        vector<string> files;
+        const json topology = experiment.value("topology", json::object());
+        if (topology.value("type", string()) == "edgeFile" && topology.contains("file")) {
+            files.push_back(topology["file"]);
+        }
+        if (topology.contains("trace")) {
+            files.push_back(topology["trace"]);
+        }
+        const json distribution = experiment.value("distribution", json::object());
+        if (distribution.contains("histogramFile")) {
+            files.push_back(distribution["histogramFile"]);
+        }
+        for (const json &channels : distribution.value("channels", json::array())) {
+            if (channels.contains("histogramFile")) {
+                files.push_back(channels["histogramFile"]);
+            }
+        }
+        string described;
+        for (const string &file : files) {
+            struct stat info;
+            described += "\n" + file;
+            if (stat(file.c_str(), &info) == 0) {
+                described += " " + std::to_string(info.st_size) + " " + std::to_string(info.st_mtim.tv_sec) + "." + std::to_string(info.st_mtim.tv_nsec);
+            }
+        }
+        return described;
+    }
+
+    inline bool ResultCache::load(const string &key, json &log)const {
+        return readLog(path(key), log);
+    }
+
+    inline void ResultCache::store(const string &key, const json &log)const {
+        // written aside and renamed, so runs sharing the cache never read half an entry
+        string temporary = path(key) + "." + std::to_string(getpid());
+        writeLog(temporary, log);
+        if (std::rename(temporary.c_str(), path(key).c_str()) != 0) {
+            std::cerr << "Error: cannot store " << path(key) << std::endl;
+            std::remove(temporary.c_str());
+        }
+    }
+
+    inline bool ResultCache::cacheable(const json &experiment) {
+        if (experiment.contains("branch") || experiment.contains("checkpoint") || experiment.contains("restore") || experiment.contains("trace")) {
+            return false;
+        }
+        for (const char *report : {"metrics", "costs", "traffic"}) {
+            if (experiment.contains(report) && experiment[report].is_object() && experiment[report].contains("file")) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool ResultCache::readLog(const string &file, json &log) {
+        std::ifstream in(file);
+        if (in.fail()) {
+            return false;
+        }
+        log = json::parse(in, nullptr, false);
+        return !log.is_discarded();
+    }
+
+    inline void ResultCache::writeLog(const string &file, const json &log) {
+        if (file == "cout") {
+            std::cout << log.dump(4) << std::endl;
+            return;
+        }
+        std::ofstream out(file);
+        if (out.fail()) {
+            std::cout << "Error: could not open file " << file << ". Writing to console" << std::endl;
+            std::cout << log.dump(4) << std::endl;
+            return;
+        }
+        out << log.dump(4) << std::endl;
+    }
+
+    inline uint64_t ResultCache::hash(const void *data, size_t size, uint64_t seed) {
+        const uint64_t m = 0xc6a4a7935bd1e995ULL;
+        const int r = 47;
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        uint64_t h = seed ^ (size * m);
+        size_t blocks = size / 8;
+        for (size_t i = 0; i < blocks; i++) {
+            uint64_t k;
+            std::memcpy(&k, bytes + i * 8, 8);
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+            h ^= k;
+            h *= m;
+        }
+        const unsigned char *tail = bytes + blocks * 8;
+        switch (size & 7) {
+            case 7: h ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+            case 6: h ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+            case 5: h ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+            case 4: h ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+            case 3: h ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+            case 2: h ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+            case 1: h ^= uint64_t(tail[0]);
+                    h *= m;
+        }
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+        return h;
+    }
+
+    inline string ResultCache::hex(uint64_t value) {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+        return text;
+    }
+}
+
+#endif /* ResultCache_hpp */
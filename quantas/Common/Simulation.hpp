@@ -11,6 +11,14 @@ You should have received a copy of the GNU General Public License along with QUA
 // initializing the network class, and repeating a simulation according to the configuration file 
 // (i.e., running multiple experiments with the same configuration).  It is templated with a user 
 // defined message and peer class, used for the underlaying network instance. 
+//
+// A run can be saved at the start of a round with "checkpoint": {"file": ..., "test": ..., "round": ...}
+// and continued from there by another run of the same configuration with "restore": file.
+//
+// With "branch": {"round": ..., "variants": [{"parameters": ..., "logFile": ...}, ...]} each test
+// runs up to the branch round once and then forks one child process per variant. The children
+// start from a copy-on-write snapshot of the warmed-up simulation, apply their parameters and
+// finish the test, and each variant's results are written to its own log file.
 
 #ifndef Simulation_hpp
 #define Simulation_hpp
@@ -18,9 +26,20 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <chrono>
 #include <thread>
 #include <fstream>
+#include <memory>
+#include <cstdio>
+#include <map>
+#include <iterator>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "Network.hpp"
 #include "LogWriter.hpp"
+#include "Metrics.hpp"
+#include "Profiler.hpp"
+#include "PerfCounters.hpp"
+#include "Probes.hpp"
 #include "BS_thread_pool.hpp"
 
 
@@ -38,6 +57,15 @@ namespace quantas {
     private:
         Network<type_msg, peer_type> 		system;
         ostream                             *_log;
+
+        // writes the state at the start of round of test to path
+        void 				saveCheckpoint	(const string &path, int test, int round);
+        // forks a child for each variant, at most parallel at a time, and adds the results of their
+        // test to results. Returns the variant in the child, with the file to hand its data back
+        // through, and -1 in the parent once every child is done
+        int 				forkBranches	(const json &variants, int test, int parallel, vector<json> &results, string &resultFile);
+        // ends a child by handing its logged data back to the parent
+        [[noreturn]] void 	finishBranch	(const string &resultFile);
     public:
         // Name of log file, will have Test number appended
         void 				run			(json);
@@ -53,6 +81,107 @@ namespace quantas {
 		return out;
 	}
 
+	template<class type_msg, class peer_type>
+	void Simulation<type_msg, peer_type>::saveCheckpoint(const string &path, int test, int round) {
+		try {
+			Checkpoint archive(path, Checkpoint::SAVE);
+			archive & test & round & LogWriter::instance()->data;
+			system.serialize(archive);
+			Metrics::instance().serialize(archive);
+			if (!archive.good()) {
+				std::cerr << "Error: cannot checkpoint, " << archive.error() << std::endl;
+				std::remove(path.c_str());
+			}
+		}
+		catch (const std::exception &e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+		}
+	}
+
+	template<class type_msg, class peer_type>
+	int Simulation<type_msg, peer_type>::forkBranches(const json &variants, int test, int parallel, vector<json> &results, string &resultFile) {
+		// anything still buffered would otherwise be written again by every child
+		cout.flush();
+		std::cerr.flush();
+		LogWriter::instance()->getLog()->flush();
+		LogWriter::instance()->flushMetrics();
+		Tracer::flush();
+
+		vector<string> files(variants.size());
+		std::map<pid_t, int> running;
+		size_t next = 0;
+		while (next < variants.size() || !running.empty()) {
+			if (next < variants.size() && running.size() < (size_t)parallel) {
+				int variant = next++;
+				char path[] = "/tmp/quantasBranchXXXXXX";
+				int fd = mkstemp(path);
+				if (fd < 0) {
+					std::cerr << "Error: cannot create a result file for variant " << variant << std::endl;
+					continue;
+				}
+				close(fd);
+				files[variant] = path;
+				pid_t pid = fork();
+				if (pid == 0) {
+					resultFile = files[variant];
+					return variant;
+				}
+				if (pid < 0) {
+					std::cerr << "Error: cannot fork variant " << variant << std::endl;
+					std::remove(path);
+					continue;
+				}
+				running[pid] = variant;
+				continue;
+			}
+
+			int status = 0;
+			pid_t pid = waitpid(-1, &status, 0);
+			if (pid < 0) {
+				break;
+			}
+			auto child = running.find(pid);
+			if (child == running.end()) {
+				continue;
+			}
+			int variant = child->second;
+			running.erase(child);
+
+			std::ifstream in(files[variant], std::ios::binary);
+			vector<uint8_t> encoded((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			in.close();
+			std::remove(files[variant].c_str());
+			json data = json::from_cbor(encoded, true, false);
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || data.is_discarded()) {
+				std::cerr << "Error: variant " << variant << " of test " << test << " failed" << std::endl;
+				continue;
+			}
+			for (auto &item : data.items()) {
+				if (item.key() != "tests") {
+					results[variant][item.key()] = item.value();
+				}
+			}
+			if (data.contains("tests") && data["tests"].size() > (size_t)test) {
+				results[variant]["tests"][test] = data["tests"][test];
+			}
+		}
+		return -1;
+	}
+
+	template<class type_msg, class peer_type>
+	void Simulation<type_msg, peer_type>::finishBranch(const string &resultFile) {
+		LogWriter::instance()->closeMetrics();
+		Tracer::close();
+		vector<uint8_t> encoded = json::to_cbor(LogWriter::instance()->data);
+		ofstream out(resultFile, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+		out.close();
+		cout.flush();
+		std::cerr.flush();
+		// the parent's thread pool and open files are not the child's to clean up
+		_exit(out.fail() ? 1 : 0);
+	}
+
 	template<class type_msg, class peer_type>
 	void Simulation<type_msg, peer_type>::run(json config) {
 		ofstream out;
@@ -84,43 +213,233 @@ namespace quantas {
 		}
 		int networkSize = static_cast<int>(config["topology"]["totalPeers"]);
 		
-		BS::thread_pool pool(_threadCount);
-		for (int i = 0; i < config["tests"]; i++) {
+		// a restored run starts at the round the checkpoint was taken
+		std::unique_ptr<Checkpoint> restore;
+		int firstTest = 0;
+		int firstRound = 0;
+		if (config.contains("restore")) {
+			try {
+				restore.reset(new Checkpoint(config["restore"], Checkpoint::RESTORE));
+				*restore & firstTest & firstRound;
+			}
+			catch (const std::exception &e) {
+				std::cerr << "Error: " << e.what() << std::endl;
+				return;
+			}
+		}
+		string checkpointFile;
+		int checkpointTest = -1;
+		int checkpointRound = -1;
+		if (config.contains("checkpoint")) {
+			checkpointFile = config["checkpoint"]["file"];
+			checkpointTest = config["checkpoint"].value("test", 0);
+			checkpointRound = config["checkpoint"].value("round", 0);
+		}
+		// a branched run hands the rounds from the branch round on to one child per variant
+		json variants = json::array();
+		int branchRound = -1;
+		int branchParallel = 1;
+		int branchVariant = -1;
+		string branchFile;
+		vector<json> branchResults;
+		if (config.contains("branch")) {
+			variants = config["branch"]["variants"];
+			branchRound = config["branch"].value("round", 0);
+			branchParallel = config["branch"].value("parallel", std::max(1, static_cast<int>(thread::hardware_concurrency()) / _threadCount));
+			branchResults.resize(variants.size(), json::object());
+			if (branchRound < 0 || branchRound >= config["rounds"]) {
+				std::cerr << "Error: branch round " << branchRound << " is not a round of the run" << std::endl;
+				return;
+			}
+		}
+
+		if (config.contains("metrics") && config["metrics"].contains("file")) {
+			LogWriter::instance()->openMetrics(config["metrics"]);
+		}
+		Metrics::instance().setInterval(config.contains("metrics") ? config["metrics"].value("interval", 1) : 1);
+		if (config.contains("trace")) {
+			Tracer::open(config["trace"].value("file", string("trace.qtrc")), config["trace"].value("ringSize", 1 << 14));
+		}
+
+		RoundProfiler profiler(config.value("profile", json(false)), _threadCount);
+		PerfCounters counters(config.value("perfCounters", json(false)));
+		system.setCosts(config.value("costs", json(false)));
+		system.setMemory(config.value("memory", json(false)));
+		system.setQueues(config.value("queues", json(false)));
+		system.setTraffic(config.value("traffic", json(false)));
+		DeliveryLatency::configure(config.value("latency", json(false)));
+		bool outOfMemory = false; // the memory budget was exceeded with "action": "abort"
+		std::unique_ptr<BS::thread_pool> pool(new BS::thread_pool(_threadCount));
+		system.setThreadPool(pool.get()); // also used to build the network
+		for (int i = firstTest; i < config["tests"]; i++) {
 			LogWriter::instance()->setTest(i);
+			Tracer::setTest(i);
+			QUANTAS_PROBE1(test__start, i);
 
 			// Configure the delay properties and initial topology of the network
+			profiler.startSetup();
 			system.setDistribution(config["distribution"]);
 			system.initNetwork(config["topology"], config["rounds"]);
 			if (config.contains("parameters")) {
 				system.initParameters(config["parameters"]);
 			}
+			Metrics::instance().reset();
+			counters.reset();
+			profiler.endSetup();
+
+			int j = 0;
+			if (restore) {
+				try {
+					*restore & LogWriter::instance()->data;
+					system.serialize(*restore);
+					Metrics::instance().serialize(*restore);
+				}
+				catch (const std::exception &e) {
+					restore->fail(e.what());
+				}
+				if (!restore->good()) {
+					std::cerr << "Error: cannot restore " << config["restore"] << ", " << restore->error() << std::endl;
+					break;
+				}
+				j = firstRound;
+				restore.reset();
+			}
+			if (i == firstTest) {
+				std::chrono::duration<double> startup = std::chrono::high_resolution_clock::now() - startTime;
+				LogWriter::instance()->data["StartupTime"] = startup.count();
+			}
 			
 			//cout << "Test " << i + 1 << endl;
-			for (int j = 0; j < config["rounds"]; j++) {
+			for (; j < config["rounds"]; j++) {
 				//cout << "ROUND " << j << endl;
+				if (i == checkpointTest && j == checkpointRound) {
+					saveCheckpoint(checkpointFile, i, j);
+				}
+				if (j == branchRound) {
+					branchVariant = forkBranches(variants, i, branchParallel, branchResults, branchFile);
+					if (branchVariant < 0) {
+						break; // the children have finished the test
+					}
+					// the pool's threads were not copied into the child, so it is left behind unjoined
+					pool.release();
+					pool.reset(new BS::thread_pool(_threadCount));
+					system.setThreadPool(pool.get());
+					profiler.resetThreads();
+					counters.resetThreads();
+					LogWriter::instance()->reopenMetrics("." + std::to_string(branchVariant));
+					Tracer::reopen("." + std::to_string(branchVariant));
+					system.updateParameters(variants[branchVariant].value("parameters", json::object()));
+				}
+				profiler.startRound();
+				QUANTAS_PROBE2(round__start, i, j);
 				LogWriter::instance()->setRound(j); // Set the round number for logging
+				counters.start();
+				system.updateTopology(); // apply this round's changes from the topology trace or dynamics, if any
+				counters.stop(RoundProfiler::TOPOLOGY);
+				profiler.endPhase(RoundProfiler::TOPOLOGY);
+				QUANTAS_PROBE3(phase__end, i, j, int(RoundProfiler::TOPOLOGY));
 
 				// do the receive phase of the round
 
-				BS::multi_future<void> receive_loop = pool.parallelize_loop(networkSize, [this](int a, int b){system.receive(a, b);});
+				BS::multi_future<void> receive_loop = pool->parallelize_loop(networkSize, profiler.timed(RoundProfiler::RECEIVE, counters.counted(RoundProfiler::RECEIVE, [this](int a, int b){system.receive(a, b);})));
 				receive_loop.wait();
+				profiler.endPhase(RoundProfiler::RECEIVE);
+				QUANTAS_PROBE3(phase__end, i, j, int(RoundProfiler::RECEIVE));
 
-				BS::multi_future<void> compute_loop = pool.parallelize_loop(networkSize, [this](int a, int b){system.performComputation(a, b);});
+				BS::multi_future<void> compute_loop = pool->parallelize_loop(networkSize, profiler.timed(RoundProfiler::COMPUTE, counters.counted(RoundProfiler::COMPUTE, [this](int a, int b){system.performComputation(a, b);})));
 				compute_loop.wait();
+				profiler.endPhase(RoundProfiler::COMPUTE);
+				QUANTAS_PROBE3(phase__end, i, j, int(RoundProfiler::COMPUTE));
 
+				counters.start();
 				system.endOfRound(); // do any end of round computations
+				Metrics::instance().sample(j == config["rounds"].get<int>() - 1); // log the metrics every interval rounds
+				counters.stop(RoundProfiler::END_OF_ROUND);
+				profiler.endPhase(RoundProfiler::END_OF_ROUND);
+				QUANTAS_PROBE3(phase__end, i, j, int(RoundProfiler::END_OF_ROUND));
 
-				BS::multi_future<void> transmit_loop = pool.parallelize_loop(networkSize, [this](int a, int b){system.transmit(a, b);});
+				BS::multi_future<void> transmit_loop = pool->parallelize_loop(networkSize, profiler.timed(RoundProfiler::TRANSMIT, counters.counted(RoundProfiler::TRANSMIT, [this](int a, int b){system.transmit(a, b);})));
 				transmit_loop.wait();
+				profiler.endPhase(RoundProfiler::TRANSMIT);
+				QUANTAS_PROBE3(phase__end, i, j, int(RoundProfiler::TRANSMIT));
+				QUANTAS_PROBE2(round__end, i, j);
+				system.endQueueRound(j);
+				if (!system.endMemoryRound(i, j)) {
+					outOfMemory = true;
+					break;
+				}
+			}
+			QUANTAS_PROBE1(test__end, i);
+			// a test the branches finish is reported by them
+			if (j == config["rounds"] || outOfMemory) {
+				json hotspots = system.reportCosts(i, branchVariant >= 0 ? "." + std::to_string(branchVariant) : "");
+				if (!hotspots.is_null()) {
+					LogWriter::instance()->data["tests"][i]["hotspots"] = hotspots;
+				}
+				json perf = counters.report();
+				if (!perf.is_null()) {
+					LogWriter::instance()->data["tests"][i]["perfCounters"] = perf;
+				}
+				json memory = system.reportMemory();
+				if (!memory.is_null()) {
+					LogWriter::instance()->data["tests"][i]["memory"] = memory;
+				}
+				json queues = system.reportQueues();
+				if (!queues.is_null()) {
+					LogWriter::instance()->data["tests"][i]["queues"] = queues;
+				}
+				json traffic = system.reportTraffic(i, branchVariant >= 0 ? "." + std::to_string(branchVariant) : "");
+				if (!traffic.is_null()) {
+					LogWriter::instance()->data["tests"][i]["traffic"] = traffic;
+				}
+			}
+			if (branchVariant >= 0) {
+				if (profiler.enabled()) {
+					LogWriter::instance()->data["profile"] = profiler.summary();
+				}
+				finishBranch(branchFile);
+			}
+			if (outOfMemory) {
+				break;
 			}
 		}
 		
+		system.setThreadPool(nullptr);
+		LogWriter::instance()->closeMetrics();
+		Tracer::close();
+		
 		endTime = std::chrono::high_resolution_clock::now();
    		duration = endTime - startTime;
 		LogWriter::instance()->data["RunTime"] = duration.count();
+		LogWriter::instance()->data["Packets"] = system.packetsSent();
+		if (profiler.enabled()) {
+			LogWriter::instance()->data["profile"] = profiler.summary();
+		}
 
 		LogWriter::instance()->print();
 		out.close();
+
+		// the experiment's own log holds the shared rounds, each variant's its whole run
+		for (size_t k = 0; k < branchResults.size(); k++) {
+			string file = variants[k].value("logFile", "cout");
+			ofstream variantOut;
+			if (file == "cout") {
+				LogWriter::instance()->setLog(cout);
+			}
+			else {
+				variantOut.open(file);
+				if (variantOut.fail()) {
+					cout << "Error: could not open file " << file << ". Writing to console" << endl;
+					LogWriter::instance()->setLog(cout);
+				}
+				else {
+					LogWriter::instance()->setLog(variantOut);
+				}
+			}
+			LogWriter::instance()->data = branchResults[k];
+			LogWriter::instance()->data["parameters"] = variants[k].value("parameters", json::object());
+			LogWriter::instance()->print();
+		}
 	}
 
 	
@@ -0,0 +1,290 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class expands the "sweep" section of an input file into experiments and runs them. The
+// section gives a base experiment and the values to vary, each named by its path in the
+// experiment ("parameters.churnRate", "topology.totalPeers", ...):
+//
+//     "sweep": {
+//       "base": { ...an experiment... },
+//       "grid": {"parameters.churnRate": [1, 2, 3], "parameters.ChurnOption": [0, 2]},
+//       "points": [{"parameters.s": 22, "topology.totalPeers": 1705}],
+//       "table": "results.json",
+//       "parallel": 8
+//     }
+//
+// The grid is the product of its axes. Given as a list of objects instead, the paths within one
+// object are an axis of their own whose values are taken together, e.g. a shard count with the
+// number of peers it needs, so they must all have as many values; a sweep with an axis whose
+// paths differ in length is refused. Points are single experiments added to the grid.
+//
+// Every experiment runs in a process of its own, as the log and the peers' parameters are
+// global, "parallel" at a time (by default one per core), the most expensive first so the last
+// to finish is a short one. The results are written to one table with a row per experiment
+// holding its values and its log.
+
+#ifndef Sweep_hpp
+#define Sweep_hpp
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "Json.hpp"
+#include "ResultCache.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class Sweep {
+    public:
+        // expands sweep into its experiments, none if it is not valid
+        Sweep                                   (const json &sweep);
+
+        // the experiments in the order they are listed in the table
+        const vector<json>&     experiments     ()const                 {return _experiments;};
+        // the values each experiment was given, by path
+        const vector<json>&     points          ()const                 {return _points;};
+        // runs every experiment with run, unless cache has its log, and writes the table
+        void                    run             (std::function<void(json)> run, const ResultCache *cache = nullptr);
+
+        // the pointer of a dotted path, "topology.totalPeers" is /topology/totalPeers
+        static json::json_pointer pointer       (const string &path);
+        // an estimate of the work of an experiment, peers times rounds times tests
+        static double           cost            (const json &experiment);
+
+    private:
+        json                    _base;
+        string                  _table;
+        int                     _parallel;
+        vector<json>            _experiments;
+        vector<json>            _points;
+
+        void                    addPoint        (const json &point);
+        // every combination of the values of axes from the first-th on, added to point
+        void                    expand          (const vector<vector<json>> &axes, size_t first, json point);
+        // forks a child running experiment with its log in logFile
+        pid_t                   start           (std::function<void(json)> &run, json experiment, const string &logFile);
+    };
+
+    inline Sweep::Sweep(const json &sweep) {
+        _base = sweep.value("base", json::object());
+        _table = sweep.value("table", _base.value("logFile", string("cout")));
+        _parallel = sweep.value("parallel", std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+
+        // an axis is the list of values its paths take together
+        vector<vector<json>> axes;
+        json grid = sweep.value("grid", json::object());
+        if (grid.is_object()) {
+            json split = json::array();
+            for (auto &axis : grid.items()) {
+                split.push_back({{axis.key(), axis.value()}});
+            }
+            grid = split;
+        }
+        for (auto &axis : grid) {
+            size_t length = 0;
+            for (auto &path : axis.items()) {
+                length = std::max(length, path.value().size());
+            }
+            vector<json> values(length, json::object());
+            for (auto &path : axis.items()) {
+                if (path.value().size() != length) {
+                    std::cerr << "Error: " << path.key() << " has " << path.value().size() << " values, the other paths of its axis " << length << ", the sweep is not run" << std::endl;
+                    return;
+                }
+                for (size_t i = 0; i < path.value().size(); i++) {
+                    values[i][path.key()] = path.value()[i];
+                }
+            }
+            if (!values.empty()) {
+                axes.push_back(values);
+            }
+        }
+        if (!axes.empty()) {
+            expand(axes, 0, json::object());
+        }
+        for (auto &point : sweep.value("points", json::array())) {
+            addPoint(point);
+        }
+    }
+
+    inline json::json_pointer Sweep::pointer(const string &path) {
+        string result;
+        size_t start = 0;
+        while (start <= path.size()) {
+            size_t end = path.find('.', start);
+            if (end == string::npos) {
+                end = path.size();
+            }
+            result += "/" + path.substr(start, end - start);
+            start = end + 1;
+        }
+        return json::json_pointer(result);
+    }
+
+    inline double Sweep::cost(const json &experiment) {
+        double peers = 1;
+        if (experiment.contains("topology")) {
+            peers = experiment["topology"].value("totalPeers", 1);
+        }
+        return peers * experiment.value("rounds", 1) * experiment.value("tests", 1);
+    }
+
+    inline void Sweep::expand(const vector<vector<json>> &axes, size_t first, json point) {
+        if (first == axes.size()) {
+            addPoint(point);
+            return;
+        }
+        for (const json &values : axes[first]) {
+            json next = point;
+            next.update(values);
+            expand(axes, first + 1, next);
+        }
+    }
+
+    inline void Sweep::addPoint(const json &point) {
+        json experiment = _base;
+        for (auto &value : point.items()) {
+            experiment[pointer(value.key())] = value.value();
+        }
+        // the experiments share the cores, so each runs on one thread unless it says otherwise
+        if (!experiment.contains("threadCount")) {
+            experiment["threadCount"] = 1;
+        }
+        _experiments.push_back(experiment);
+        _points.push_back(point);
+    }
+
+    inline pid_t Sweep::start(std::function<void(json)> &run, json experiment, const string &logFile) {
+        std::cout.flush();
+        std::cerr.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            experiment["logFile"] = logFile;
+            run(experiment);
+            std::cout.flush();
+            std::cerr.flush();
+            _exit(0);
+        }
+        return pid;
+    }
+
+    inline void Sweep::run(std::function<void(json)> run, const ResultCache *cache) {
+        // a refused sweep leaves any table of an earlier run as it is
+        if (_experiments.empty()) {
+            return;
+        }
+        vector<json> results(_experiments.size());
+        vector<string> keys(_experiments.size());
+        vector<size_t> order;
+        for (size_t i = 0; i < _experiments.size(); i++) {
+            if (cache && ResultCache::cacheable(_experiments[i])) {
+                keys[i] = cache->key(_experiments[i]);
+                if (cache->load(keys[i], results[i])) {
+                    continue;
+                }
+            }
+            order.push_back(i);
+        }
+        // largest first
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return cost(_experiments[a]) > cost(_experiments[b]);
+        });
+
+        vector<string> logs(_experiments.size());
+        std::map<pid_t, size_t> running;
+        size_t next = 0;
+        while (next < order.size() || !running.empty()) {
+            if (next < order.size() && running.size() < (size_t)_parallel) {
+                size_t experiment = order[next++];
+                char path[] = "/tmp/quantasSweepXXXXXX";
+                int fd = mkstemp(path);
+                if (fd < 0) {
+                    std::cerr << "Error: cannot create a log file for experiment " << experiment << std::endl;
+                    continue;
+                }
+                close(fd);
+                logs[experiment] = path;
+                pid_t pid = start(run, _experiments[experiment], path);
+                if (pid < 0) {
+                    std::cerr << "Error: cannot fork experiment " << experiment << std::endl;
+                    std::remove(path);
+                    continue;
+                }
+                running[pid] = experiment;
+                continue;
+            }
+
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                break;
+            }
+            auto child = running.find(pid);
+            if (child == running.end()) {
+                continue;
+            }
+            size_t experiment = child->second;
+            running.erase(child);
+
+            std::ifstream in(logs[experiment]);
+            results[experiment] = json::parse(in, nullptr, false);
+            in.close();
+            std::remove(logs[experiment].c_str());
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || results[experiment].is_discarded()) {
+                std::cerr << "Error: experiment " << _points[experiment].dump() << " failed" << std::endl;
+                results[experiment] = nullptr;
+            }
+            else if (!keys[experiment].empty()) {
+                cache->store(keys[experiment], results[experiment]);
+            }
+        }
+
+        // the table lists the paths that were varied and a row for each experiment
+        std::set<string> paths;
+        for (const json &point : _points) {
+            for (auto &value : point.items()) {
+                paths.insert(value.key());
+            }
+        }
+        json table;
+        table["keys"] = paths;
+        table["rows"] = json::array();
+        for (size_t i = 0; i < _experiments.size(); i++) {
+            json row = _points[i];
+            row["results"] = results[i];
+            table["rows"].push_back(row);
+        }
+
+        std::ofstream out;
+        if (_table != "cout") {
+            out.open(_table);
+            if (out.fail()) {
+                std::cout << "Error: could not open file " << _table << ". Writing to console" << std::endl;
+            }
+        }
+        std::ostream &log = out.is_open() ? static_cast<std::ostream&>(out) : std::cout;
+        log << table.dump(4) << std::endl;
+    }
+}
+
+#endif /* Sweep_hpp */
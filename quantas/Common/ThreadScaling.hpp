@@ -0,0 +1,226 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class measures how an experiment scales with its thread count, when it is given
+//
+//     "threadScaling": {"threads": [1, 2, 4, 8], "repeats": 3, "minEfficiency": 0.7}
+//
+// (or true, for 1, 2, 4, ... up to the number of cores). The experiment is run profiled once per
+// thread count, "repeats" times keeping the fastest, each run in a process of its own and one at
+// a time, and its log file gets the report instead of a run's log:
+//
+//     "runs": [{"threads", "seconds", "speedup", "efficiency", "karpFlatt", "amdahl",
+//               "breakdown": {"setup", "topology", "endOfRound", "parallel", "barrierWait", "other"}}, ...]
+//     "serialFraction": {"total", "setup", "topology", "endOfRound", "other"}
+//     "maxSpeedup", "recommendedThreads"
+//
+// Speedups are over the run with the fewest threads. The breakdown is in seconds: the setup of the
+// tests (building the network), the phases run on the main thread, the wall time of the phases run
+// on the pool, and of that the time the mean thread spent waiting at the barriers; other is what the
+// profile does not cover, e.g. writing the log. The serial fraction is the share of the fewest
+// threads' run that is not in the pool's phases, for which Amdahl's law predicts the "amdahl"
+// speedup of each run; karpFlatt is the serial fraction the measured speedup implies, which grows
+// with the thread count when the barriers and the pool cost more than they bring. The recommended
+// thread count is the largest whose efficiency is at least "minEfficiency" (0.7).
+
+#ifndef ThreadScaling_hpp
+#define ThreadScaling_hpp
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "Json.hpp"
+#include "ResultCache.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    class ThreadScaling {
+    public:
+        // experiment is the one to measure, with its "threadScaling"
+        ThreadScaling                           (const json &experiment);
+
+        // runs the experiment at each thread count with run and writes the report to its log file
+        void                    run             (std::function<void(json)> run);
+
+    private:
+        json                    _experiment;
+        string                  _logFile;
+        vector<int>             _threads;
+        int                     _repeats;
+        double                  _minEfficiency;
+
+        // the log of experiment run in a child process, null if it failed
+        json                    runOnce         (std::function<void(json)> &run, json experiment);
+        // the times of a profiled run, in seconds
+        static json             breakdown       (const json &log);
+    };
+
+    inline ThreadScaling::ThreadScaling(const json &experiment) {
+        json scaling = experiment["threadScaling"];
+        _experiment = experiment;
+        _experiment.erase("threadScaling");
+        _logFile = experiment.value("logFile", string("cout"));
+        _repeats = scaling.is_object() ? std::max(1, scaling.value("repeats", 1)) : 1;
+        _minEfficiency = scaling.is_object() ? scaling.value("minEfficiency", 0.7) : 0.7;
+
+        int peers = experiment["topology"].value("totalPeers", 1);
+        if (scaling.is_object() && scaling.contains("threads")) {
+            _threads = scaling["threads"].get<vector<int>>();
+        }
+        else {
+            int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            for (int t = 1; t < cores; t *= 2) {
+                _threads.push_back(t);
+            }
+            _threads.push_back(cores);
+        }
+        // the simulation runs no more threads than there are peers
+        for (int &t : _threads) {
+            t = std::max(1, std::min(t, peers));
+        }
+        std::sort(_threads.begin(), _threads.end());
+        _threads.erase(std::unique(_threads.begin(), _threads.end()), _threads.end());
+    }
+
+    inline json ThreadScaling::runOnce(std::function<void(json)> &run, json experiment) {
+        char path[] = "/tmp/quantasScalingXXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            std::cerr << "Error: cannot create a log file for thread scaling" << std::endl;
+            return nullptr;
+        }
+        close(fd);
+        std::cout.flush();
+        std::cerr.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            experiment["logFile"] = string(path);
+            run(experiment);
+            std::cout.flush();
+            std::cerr.flush();
+            _exit(0);
+        }
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::remove(path);
+            return nullptr;
+        }
+        json log;
+        bool read = ResultCache::readLog(path, log);
+        std::remove(path);
+        return read ? log : json(nullptr);
+    }
+
+    inline json ThreadScaling::breakdown(const json &log) {
+        const json &profile = log["profile"];
+        auto seconds = [&](const char *phase) {
+            return profile["phases"][phase].value("total", 0.0) / 1000;
+        };
+        json times;
+        times["setup"] = profile["setup"].value("total", 0.0) / 1000;
+        times["topology"] = seconds("topology");
+        times["endOfRound"] = seconds("endOfRound");
+        times["parallel"] = seconds("receive") + seconds("performComputation") + seconds("transmit");
+        double wait = 0;
+        for (const json &thread : profile["threads"]) {
+            for (auto &phase : thread["wait"].items()) {
+                wait += phase.value().get<double>() / 1000;
+            }
+        }
+        times["barrierWait"] = profile["threads"].empty() ? 0.0 : wait / profile["threads"].size();
+        double covered = times["setup"].get<double>() + times["topology"].get<double>() + times["endOfRound"].get<double>() + times["parallel"].get<double>();
+        times["other"] = std::max(0.0, log.value("RunTime", 0.0) - covered);
+        return times;
+    }
+
+    inline void ThreadScaling::run(std::function<void(json)> run) {
+        // the runs measure the simulation alone
+        json experiment = _experiment;
+        experiment["profile"] = true;
+        for (const char *key : {"checkpoint", "restore", "branch", "trace"}) {
+            experiment.erase(key);
+        }
+
+        json runs = json::array();
+        for (int threads : _threads) {
+            experiment["threadCount"] = threads;
+            json fastest;
+            for (int r = 0; r < _repeats; r++) {
+                json log = runOnce(run, experiment);
+                if (log.is_null() || !log.contains("profile")) {
+                    std::cerr << "Error: the run with " << threads << " threads failed" << std::endl;
+                    continue;
+                }
+                if (fastest.is_null() || log.value("RunTime", 0.0) < fastest.value("RunTime", 0.0)) {
+                    fastest = log;
+                }
+            }
+            if (fastest.is_null()) {
+                continue;
+            }
+            json entry;
+            entry["threads"] = threads;
+            entry["seconds"] = fastest.value("RunTime", 0.0);
+            entry["breakdown"] = breakdown(fastest);
+            runs.push_back(entry);
+        }
+
+        json report;
+        report["experiment"] = _experiment;
+        report["runs"] = runs;
+        if (!runs.empty()) {
+            const json &base = runs[0];
+            double baseSeconds = std::max(base["seconds"].get<double>(), 1e-9);
+            int baseThreads = base["threads"];
+            // the share of the fewest threads' run outside the pool's phases
+            json serial;
+            double total = 0;
+            for (const char *part : {"setup", "topology", "endOfRound", "other"}) {
+                serial[part] = base["breakdown"][part].get<double>() / baseSeconds;
+                total += serial[part].get<double>();
+            }
+            serial["total"] = total;
+            report["serialFraction"] = serial;
+            report["maxSpeedup"] = total > 0 ? 1 / total : 0.0;
+
+            int recommended = baseThreads;
+            for (json &entry : runs) {
+                int threads = entry["threads"];
+                double ratio = double(threads) / baseThreads;
+                double speedup = baseSeconds / std::max(entry["seconds"].get<double>(), 1e-9);
+                entry["speedup"] = speedup;
+                entry["efficiency"] = speedup / ratio;
+                entry["amdahl"] = 1 / (total + (1 - total) / ratio);
+                if (ratio > 1) {
+                    entry["karpFlatt"] = (1 / speedup - 1 / ratio) / (1 - 1 / ratio);
+                }
+                if (speedup / ratio >= _minEfficiency) {
+                    recommended = threads;
+                }
+            }
+            report["runs"] = runs;
+            report["recommendedThreads"] = recommended;
+        }
+        ResultCache::writeLog(_logFile, json({{"threadScaling", report}}));
+    }
+}
+
+#endif /* ThreadScaling_hpp */
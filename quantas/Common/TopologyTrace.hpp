@@ -0,0 +1,126 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class reads a trace of topology changes (edges added and removed each round) from a binary
+// file, e.g. a mobility or churn trace. The file is memory-mapped and consumed front to back, one
+// round at a time; pages behind the current round are released so that a trace with millions of
+// events does not stay resident for the whole simulation.
+//
+// Layout (native endianness):
+//   Header      magic "QDLT", version, number of events
+//   events      TopologyEvent records sorted by round, then by source
+//
+// Files are produced offline from a text delta list by Tools/DeltaListToTrace.cpp.
+
+#ifndef TopologyTrace_hpp
+#define TopologyTrace_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <stdexcept>
+#include "MappedFile.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+
+    // a directed edge from source to target is added or removed at the start of round
+    struct TopologyEvent {
+        static const uint32_t   ADD_EDGE    = 0;
+        static const uint32_t   REMOVE_EDGE = 1;
+
+        uint32_t    round;
+        uint32_t    source;
+        uint32_t    target;
+        uint32_t    op;
+    };
+
+    class TopologyTrace {
+    public:
+        static const uint32_t   MAGIC   = 0x544c4451; // "QDLT"
+        static const uint32_t   VERSION = 1;
+
+        struct Header {
+            uint32_t    magic;
+            uint32_t    version;
+            uint64_t    events;
+        };
+
+        // maps path, or returns the mapping already made for it
+        static std::shared_ptr<const TopologyTrace> open(const string &path);
+        // writes a trace, events must already be sorted
+        static void                 write       (const string &path, const vector<TopologyEvent> &events);
+
+        size_t                      size        ()const                 {return _header->events;};
+        const TopologyEvent*        begin       ()const                 {return _events;};
+        const TopologyEvent*        end         ()const                 {return _events + size();};
+        // the events before position will not be read again in this test
+        void                        release     (size_t position)const  {_file.release(sizeof(Header) + position * sizeof(TopologyEvent));};
+
+    private:
+        TopologyTrace                           (const string &path);
+
+        MappedFile                  _file;
+        const Header                *_header = nullptr;
+        const TopologyEvent         *_events = nullptr;
+    };
+
+    inline std::shared_ptr<const TopologyTrace> TopologyTrace::open(const string &path) {
+        static std::mutex                                              cacheMutex;
+        static std::map<string, std::shared_ptr<const TopologyTrace>>  cache;
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(path);
+        if (it == cache.end()) {
+            it = cache.emplace(path, std::shared_ptr<const TopologyTrace>(new TopologyTrace(path))).first;
+        }
+        return it->second;
+    }
+
+    inline TopologyTrace::TopologyTrace(const string &path) : _file(path) {
+        if (_file.size() < sizeof(Header)) {
+            throw std::runtime_error("topology trace " + path + " is truncated");
+        }
+        _file.advise(MADV_SEQUENTIAL);
+        _header = reinterpret_cast<const Header*>(_file.data());
+        if (_header->magic != MAGIC || _header->version != VERSION) {
+            throw std::runtime_error(path + " is not a QUANTAS topology trace");
+        }
+        // divided rather than multiplied so that a damaged count cannot overflow past the check
+        if (_header->events > (_file.size() - sizeof(Header)) / sizeof(TopologyEvent)) {
+            throw std::runtime_error("topology trace " + path + " is truncated");
+        }
+        _events = reinterpret_cast<const TopologyEvent*>(_file.data() + sizeof(Header));
+    }
+
+    inline void TopologyTrace::write(const string &path, const vector<TopologyEvent> &events) {
+        std::ofstream out(path, std::ios::binary);
+        if (out.fail()) {
+            throw std::runtime_error("cannot create topology trace " + path);
+        }
+        Header header;
+        std::memset(&header, 0, sizeof(Header));
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.events = events.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        out.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(TopologyEvent));
+        if (out.fail()) {
+            throw std::runtime_error("cannot write topology trace " + path);
+        }
+    }
+}
+
+#endif /* TopologyTrace_hpp */
@@ -0,0 +1,339 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class traces every packet the network interfaces send, drop and receive into a binary
+// file, when an experiment asks for it with "trace": {"file": "run.qtrc"}. Each thread writes
+// fixed-size records into a ring of its own, which a background thread empties into the file,
+// so tracing a packet costs a copy and never waits for another thread unless its ring is full.
+// When no trace is open, enabled() is false and the interfaces skip tracing altogether.
+//
+// The file is the magic "QTRC", the version and the size of a record, then blocks. A block starts
+// with its type and count: tags (id, length, characters) name the message types first used since
+// the previous block, records are count Records. Native endianness; read it with
+// Tools/TraceAnalyzer.
+//
+// A record's type is the tag of the message's messageType or action, for messages that have one,
+// and its size is the size of the message structure, not of what it points to.
+
+#ifndef Tracer_hpp
+#define Tracer_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <type_traits>
+#include <algorithm>
+#include <utility>
+#include <iostream>
+#include "FileName.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+
+    class Tracer {
+    public:
+        static const uint32_t   MAGIC           = 0x43525451; // "QTRC"
+        static const uint32_t   VERSION         = 1;
+        enum Block : uint32_t { TAGS = 1, RECORDS = 2 };
+        enum Event : uint16_t { SEND = 0, RECEIVE = 1, DROP = 2 };
+
+        struct Record {
+            int32_t             test;
+            int32_t             round;          // round the event happened in
+            int32_t             source;
+            int32_t             target;
+            int32_t             delay;          // rounds the packet spends on the channel
+            uint32_t            size;           // bytes
+            uint32_t            type;           // tag of the message type
+            uint16_t            event;
+            uint16_t            thread;         // the ring the record was written to
+        };
+
+        // true while a trace is open
+        static bool             enabled         ()                      {return _current.load(std::memory_order_relaxed) != nullptr;};
+        static void             trace           (Event event, int round, long source, long target, int delay, size_t size, uint32_t type);
+        // the tag of a message type name, 0 is the tag of messages without one
+        static uint32_t         tag             (const string &name);
+        static void             setTest         (int test);
+
+        // opens file, each thread's ring holding ringSize records
+        static bool             open            (const string &file, size_t ringSize = 1 << 14);
+        // waits until everything traced so far is in the file
+        static void             flush           ();
+        static void             close           ();
+        // opens the trace again with suffix added, in a forked child, where the writing thread of
+        // the parent's trace does not exist
+        static void             reopen          (const string &suffix);
+
+        ~Tracer                                 ();
+
+    private:
+        // written by one thread, emptied by the writing thread
+        struct Ring {
+            vector<Record>      slots;
+            alignas(64) std::atomic<uint64_t> head {0};
+            alignas(64) std::atomic<uint64_t> tail {0};
+        };
+
+        static std::atomic<Tracer*> _current;
+        static std::atomic<uint64_t> _generation;
+
+        string                  _file;
+        FILE                    *_out = nullptr;
+        size_t                  _ringSize;
+        uint64_t                _id;
+        std::atomic<int32_t>    _test {0};
+        std::mutex              _ringMutex;
+        vector<std::unique_ptr<Ring>> _rings;
+        std::mutex              _tagMutex;
+        std::unordered_map<string, uint32_t> _tags;
+        vector<std::pair<uint32_t, string>> _newTags;
+        // held while emptying the rings, by the writing thread or flush
+        std::mutex              _drainMutex;
+        std::atomic<bool>       _stopping {false};
+        std::thread             _thread;
+
+        Tracer                                  (const string &file, size_t ringSize);
+        Tracer                                  (const Tracer&) = delete;
+
+        // the calling thread's ring in this trace
+        Ring&                   local           ();
+        uint32_t                tagOf           (const string &name);
+        // writes what the rings hold, returns false if they were empty
+        bool                    drain           ();
+        void                    run             ();
+    };
+
+    inline std::atomic<Tracer*> Tracer::_current {nullptr};
+    inline std::atomic<uint64_t> Tracer::_generation {0};
+
+    // the tag of msg's messageType or action member, 0 if it has neither
+    template<class T, class = void>
+    struct hasMessageType : std::false_type {};
+    template<class T>
+    struct hasMessageType<T, std::void_t<decltype(std::declval<const T&>().messageType)>> : std::true_type {};
+    template<class T, class = void>
+    struct hasAction : std::false_type {};
+    template<class T>
+    struct hasAction<T, std::void_t<decltype(std::declval<const T&>().action)>> : std::true_type {};
+
+    template<class message>
+    uint32_t traceType(const message &msg) {
+        if constexpr (hasMessageType<message>::value) {
+            return Tracer::tag(msg.messageType);
+        }
+        else if constexpr (hasAction<message>::value) {
+            return Tracer::tag(msg.action);
+        }
+        else {
+            return 0;
+        }
+    }
+
+    inline Tracer::Tracer(const string &file, size_t ringSize) : _file(file), _ringSize(ringSize < 2 ? 2 : ringSize) {
+        _id = ++_generation;
+        _out = fopen(file.c_str(), "wb");
+        if (_out == nullptr) {
+            std::cerr << "Error: cannot open trace file " << file << std::endl;
+            return;
+        }
+        uint32_t header[3] = {MAGIC, VERSION, sizeof(Record)};
+        fwrite(header, sizeof(header), 1, _out);
+        _tags[""] = 0;
+        _newTags.emplace_back(0, "");
+        _thread = std::thread(&Tracer::run, this);
+    }
+
+    inline Tracer::~Tracer() {
+        if (_thread.joinable()) {
+            _stopping = true;
+            _thread.join();
+        }
+        if (_out != nullptr) {
+            drain();
+            fclose(_out);
+        }
+    }
+
+    inline bool Tracer::open(const string &file, size_t ringSize) {
+        close();
+        Tracer *tracer = new Tracer(file, ringSize);
+        if (tracer->_out == nullptr) {
+            delete tracer;
+            return false;
+        }
+        _current = tracer;
+        return true;
+    }
+
+    inline void Tracer::close() {
+        delete _current.exchange(nullptr);
+    }
+
+    inline void Tracer::flush() {
+        Tracer *tracer = _current;
+        if (tracer != nullptr) {
+            tracer->drain();
+            fflush(tracer->_out);
+        }
+    }
+
+    inline void Tracer::reopen(const string &suffix) {
+        Tracer *tracer = _current.exchange(nullptr);
+        if (tracer == nullptr) {
+            return;
+        }
+        // the parent's tracer is left as it is, its thread and its file belong to the parent
+        string file = withSuffix(tracer->_file, suffix);
+        int32_t test = tracer->_test;
+        if (open(file, tracer->_ringSize)) {
+            setTest(test);
+        }
+    }
+
+    inline void Tracer::setTest(int test) {
+        Tracer *tracer = _current;
+        if (tracer != nullptr) {
+            tracer->_test = test;
+        }
+    }
+
+    inline uint32_t Tracer::tag(const string &name) {
+        Tracer *tracer = _current.load(std::memory_order_relaxed);
+        return tracer == nullptr ? 0 : tracer->tagOf(name);
+    }
+
+    // each thread remembers the tags it has used, so the shared table is only locked for new names
+    inline uint32_t Tracer::tagOf(const string &name) {
+        thread_local uint64_t generation = 0;
+        thread_local std::unordered_map<string, uint32_t> known;
+        if (generation != _id) {
+            generation = _id;
+            known.clear();
+        }
+        auto found = known.find(name);
+        if (found != known.end()) {
+            return found->second;
+        }
+        std::lock_guard<std::mutex> lock(_tagMutex);
+        auto inserted = _tags.emplace(name, static_cast<uint32_t>(_tags.size()));
+        if (inserted.second) {
+            _newTags.emplace_back(inserted.first->second, name);
+        }
+        known[name] = inserted.first->second;
+        return inserted.first->second;
+    }
+
+    inline Tracer::Ring& Tracer::local() {
+        thread_local uint64_t generation = 0;
+        thread_local Ring *ring = nullptr;
+        if (generation != _id) {
+            std::lock_guard<std::mutex> lock(_ringMutex);
+            _rings.emplace_back(new Ring());
+            _rings.back()->slots.resize(_ringSize);
+            ring = _rings.back().get();
+            generation = _id;
+        }
+        return *ring;
+    }
+
+    inline void Tracer::trace(Event event, int round, long source, long target, int delay, size_t size, uint32_t type) {
+        Tracer *tracer = _current.load(std::memory_order_relaxed);
+        if (tracer == nullptr) {
+            return;
+        }
+        Ring &ring = tracer->local();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        // a full ring waits for the writing thread rather than losing records
+        while (head - ring.tail.load(std::memory_order_acquire) >= ring.slots.size()) {
+            std::this_thread::yield();
+        }
+        Record &record = ring.slots[head % ring.slots.size()];
+        record.test = tracer->_test.load(std::memory_order_relaxed);
+        record.round = round;
+        record.source = static_cast<int32_t>(source);
+        record.target = static_cast<int32_t>(target);
+        record.delay = delay;
+        record.size = static_cast<uint32_t>(size);
+        record.type = type;
+        record.event = event;
+        record.thread = 0;
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    inline bool Tracer::drain() {
+        std::lock_guard<std::mutex> drainLock(_drainMutex);
+        vector<Ring*> rings;
+        {
+            std::lock_guard<std::mutex> lock(_ringMutex);
+            for (auto &ring : _rings) {
+                rings.push_back(ring.get());
+            }
+        }
+        // the heads are read before the tags, so every record read has its tag written first
+        vector<uint64_t> heads(rings.size());
+        bool any = false;
+        for (size_t r = 0; r < rings.size(); r++) {
+            heads[r] = rings[r]->head.load(std::memory_order_acquire);
+            any = any || heads[r] != rings[r]->tail.load(std::memory_order_relaxed);
+        }
+        vector<std::pair<uint32_t, string>> tags;
+        {
+            std::lock_guard<std::mutex> lock(_tagMutex);
+            tags.swap(_newTags);
+        }
+        if (!tags.empty()) {
+            uint32_t block[2] = {TAGS, static_cast<uint32_t>(tags.size())};
+            fwrite(block, sizeof(block), 1, _out);
+            for (auto &tag : tags) {
+                uint32_t entry[2] = {tag.first, static_cast<uint32_t>(tag.second.size())};
+                fwrite(entry, sizeof(entry), 1, _out);
+                fwrite(tag.second.data(), 1, tag.second.size(), _out);
+            }
+        }
+        for (size_t r = 0; r < rings.size(); r++) {
+            Ring &ring = *rings[r];
+            uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+            size_t capacity = ring.slots.size();
+            while (tail != heads[r]) {
+                // up to the end of the ring's storage, then from its start
+                size_t first = tail % capacity;
+                size_t count = std::min<uint64_t>(heads[r] - tail, capacity - first);
+                for (size_t i = first; i < first + count; i++) {
+                    ring.slots[i].thread = static_cast<uint16_t>(r);
+                }
+                uint32_t block[2] = {RECORDS, static_cast<uint32_t>(count)};
+                fwrite(block, sizeof(block), 1, _out);
+                fwrite(&ring.slots[first], sizeof(Record), count, _out);
+                tail += count;
+                ring.tail.store(tail, std::memory_order_release);
+            }
+        }
+        return any;
+    }
+
+    inline void Tracer::run() {
+        while (!_stopping) {
+            if (!drain()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+}
+
+#endif /* Tracer_hpp */
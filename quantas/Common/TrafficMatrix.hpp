@@ -0,0 +1,201 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// This class collects how many messages and bytes went over each directed edge of the network
+// during a test, when an experiment asks for it with
+//
+//     "traffic": {"file": "traffic.csv", "format": "csv", "top": 10}
+//
+// The counting is done by transmit: each interface keeps a LinkTraffic per neighbor, in the order
+// of its neighbors, the row of the matrix the thread running the peer adds to without locking.
+// Packets sent to a neighbor since removed are kept apart by target. At the end of the test the
+// rows are gathered into the edges with any traffic, sorted by source and target, and written to
+// the file (branches add their variant's number to its name), as csv lines
+//
+//     test,source,target,messages,bytes
+//
+// or with "format": "binary" as a header of the uint32s MAGIC and VERSION followed by a Record per
+// edge. The test's log gets "traffic": the edges and the messages and bytes in all, and the "top"
+// edges, senders and receivers by messages.
+//
+// Bytes are the size of the message type, as in traces. Packets a peer sends itself and those
+// dropped for not going to a neighbor are not on an edge, and not counted.
+
+#ifndef TrafficMatrix_hpp
+#define TrafficMatrix_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include "Json.hpp"
+#include "Checkpoint.hpp"
+#include "FileName.hpp"
+
+namespace quantas {
+
+    using std::string;
+    using std::vector;
+    using nlohmann::json;
+
+    // what went over one directed edge
+    struct LinkTraffic {
+        uint64_t                messages = 0;
+        uint64_t                bytes = 0;
+        LinkTraffic&            operator+=      (const LinkTraffic &other)  {messages += other.messages; bytes += other.bytes; return *this;};
+    };
+
+    class TrafficMatrix {
+    public:
+        static const uint32_t   MAGIC           = 0x46525451; // "QTRF"
+        static const uint32_t   VERSION         = 1;
+
+        struct Edge {
+            long                source;
+            long                target;
+            LinkTraffic         traffic;
+        };
+        struct Record {
+            int32_t             test;
+            int32_t             source;
+            int32_t             target;
+            uint32_t            reserved;
+            uint64_t            messages;
+            uint64_t            bytes;
+        };
+
+        // traffic is the experiment's "traffic", counting is off without it
+        void                    configure       (const json &traffic);
+        bool                    enabled         ()const                 {return _enabled;};
+
+        // logs the totals and top edges of test and writes its edges to the file. suffix is added
+        // to the file's name, before its extension
+        json                    report          (int test, vector<Edge> &edges, const string &suffix = "");
+        // checks a checkpoint counted traffic as this run does, the counts are the interfaces'
+        void                    serialize       (Checkpoint &archive);
+
+    private:
+        bool                    _enabled = false;
+        bool                    _binary = false;
+        size_t                  _top = 10;
+        string                  _file;
+        // the file written last, a new one is started rather than added to
+        string                  _written;
+
+        bool                    write           (int test, const vector<Edge> &edges, const string &suffix);
+        // the top peers by the messages they sent or received, in totals
+        json                    topPeers        (const std::map<long, LinkTraffic> &totals)const;
+    };
+
+    inline void TrafficMatrix::configure(const json &traffic) {
+        _enabled = traffic.is_object() || (traffic.is_boolean() && traffic.get<bool>());
+        _top = traffic.is_object() ? traffic.value("top", 10) : 10;
+        _file = traffic.is_object() ? traffic.value("file", string()) : string();
+        _binary = traffic.is_object() && traffic.value("format", string("csv")) == "binary";
+    }
+
+    inline json TrafficMatrix::topPeers(const std::map<long, LinkTraffic> &totals)const {
+        vector<std::pair<long, LinkTraffic>> peers(totals.begin(), totals.end());
+        size_t count = std::min(_top, peers.size());
+        std::partial_sort(peers.begin(), peers.begin() + count, peers.end(), [](const std::pair<long, LinkTraffic> &a, const std::pair<long, LinkTraffic> &b) {
+            return a.second.messages != b.second.messages ? a.second.messages > b.second.messages : a.first < b.first;
+        });
+        json list = json::array();
+        for (size_t k = 0; k < count; k++) {
+            list.push_back({{"peer", peers[k].first}, {"messages", peers[k].second.messages}, {"bytes", peers[k].second.bytes}});
+        }
+        return list;
+    }
+
+    inline bool TrafficMatrix::write(int test, const vector<Edge> &edges, const string &suffix) {
+        string file = withSuffix(_file, suffix);
+        bool started = file == _written;
+        std::ios::openmode mode = (started ? std::ios::app : std::ios::trunc) | (_binary ? std::ios::binary : std::ios::openmode());
+        std::ofstream out(file, mode);
+        if (out.fail()) {
+            std::cerr << "Error: cannot open traffic file " << file << std::endl;
+            return false;
+        }
+        if (_binary) {
+            if (!started) {
+                uint32_t header[2] = {MAGIC, VERSION};
+                out.write(reinterpret_cast<const char*>(header), sizeof(header));
+            }
+            vector<Record> records(edges.size());
+            for (size_t e = 0; e < edges.size(); e++) {
+                records[e] = {test, int32_t(edges[e].source), int32_t(edges[e].target), 0, edges[e].traffic.messages, edges[e].traffic.bytes};
+            }
+            out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        }
+        else {
+            if (!started) {
+                out << "test,source,target,messages,bytes\n";
+            }
+            for (const Edge &edge : edges) {
+                out << test << "," << edge.source << "," << edge.target << "," << edge.traffic.messages << "," << edge.traffic.bytes << "\n";
+            }
+        }
+        _written = file;
+        return true;
+    }
+
+    inline void TrafficMatrix::serialize(Checkpoint &archive) {
+        bool enabled = _enabled;
+        archive & enabled;
+        if (enabled != _enabled) {
+            archive.fail("the checkpoint was taken with other \"traffic\" settings");
+        }
+    }
+
+    inline json TrafficMatrix::report(int test, vector<Edge> &edges, const string &suffix) {
+        json traffic;
+        if (!_enabled) {
+            return traffic;
+        }
+        std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+            return a.source != b.source ? a.source < b.source : a.target < b.target;
+        });
+        LinkTraffic total;
+        std::map<long, LinkTraffic> sent, received;
+        for (const Edge &edge : edges) {
+            total += edge.traffic;
+            sent[edge.source] += edge.traffic;
+            received[edge.target] += edge.traffic;
+        }
+        traffic["edges"] = edges.size();
+        traffic["messages"] = total.messages;
+        traffic["bytes"] = total.bytes;
+
+        // the busiest edges, most messages first and by source and target among equals
+        vector<const Edge*> order;
+        for (const Edge &edge : edges) {
+            order.push_back(&edge);
+        }
+        size_t count = std::min(_top, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(), [](const Edge *a, const Edge *b) {
+            return a->traffic.messages != b->traffic.messages ? a->traffic.messages > b->traffic.messages : a < b;
+        });
+        traffic["top"] = json::array();
+        for (size_t k = 0; k < count; k++) {
+            traffic["top"].push_back({{"source", order[k]->source}, {"target", order[k]->target}, {"messages", order[k]->traffic.messages}, {"bytes", order[k]->traffic.bytes}});
+        }
+        traffic["topSenders"] = topPeers(sent);
+        traffic["topReceivers"] = topPeers(received);
+
+        if (!_file.empty()) {
+            write(test, edges, suffix);
+        }
+        return traffic;
+    }
+}
+
+#endif /* TrafficMatrix_hpp */
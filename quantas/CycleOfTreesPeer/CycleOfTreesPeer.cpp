@@ -14,9 +14,8 @@ namespace quantas {
 	int CycleOfTreesPeer::noOfEdges                = 0;
 	int CycleOfTreesPeer::noOfCycleNodes           = 0;
 	int                   numberOfNodes            = 0;
-	vector<list<int>>     allEdges;
-	vector<list<int>>     unusedEdges;
-	vector<list<int>>     presentEdges;
+	// edges of the backbone, taking turns being present
+	EdgeRotation          rotation;
 	double                avgKnotOutputNumerator   = 0;
 	double                avgKnotOutputDenominator = 0;
 	bool                  firstDetected            = false;
@@ -52,21 +51,23 @@ namespace quantas {
 			cout << "invalid input for cycle size; must be in interval [2, network size]" << endl;
 		}
 
+		vector<EdgeRotation::Edge> allEdges;
+
 		// create cycle
                 for (int i = 1; i < cycleSize; ++i) {
-			allEdges.push_back(list<int>{(i - 1), i});
+			allEdges.push_back({(uint32_t)(i - 1), (uint32_t)i});
                 }
-		allEdges.push_back(list<int>{(cycleSize - 1), 0});
+		allEdges.push_back({(uint32_t)(cycleSize - 1), 0});
 
                 // create random trees
 		numberOfNodes = _peers.size();
                 int positionedPeerID = 0;
                 for (int i = cycleSize; i < numberOfNodes; ++i) {
 			positionedPeerID = uniformInt(0, (i - 1));    // interval: [0, i - 1]
-			allEdges.push_back(list<int>{positionedPeerID, i});
+			allEdges.push_back({(uint32_t)positionedPeerID, (uint32_t)i});
                 }
 
-		unusedEdges = allEdges;
+		rotation = EdgeRotation(std::move(allEdges), numberOfEdges);
 
 		pickEdges();
 	}
@@ -98,9 +99,7 @@ namespace quantas {
 			avgKnotOutputDenominator = 0;
 			numberOfNodes            = 0;
 
-			allEdges.clear();
-			unusedEdges.clear();
-			presentEdges.clear();
+			rotation = EdgeRotation();
 
 			/*cout << "Highest ID is: ";    // testing every node has detected the same highest ID
 			std::for_each(peers.begin(), peers.end(),
@@ -141,46 +140,27 @@ namespace quantas {
 
 		if (highestID == -1) {   // the cycle has not been detected yet
 			message.nodesMessageHasReached = nodesHeardFrom;
-			std::for_each(presentEdges.begin(), presentEdges.end(), [=](list<int> edge) {
-				if (edge.front() == id()) {
-					unicastTo(message, edge.back());
+			for (const EdgeRotation::Edge &edge : rotation.present()) {
+				if (edge.first == id()) {
+					unicastTo(message, edge.second);
 				}
-				});
+			}
 		}
 
 		else {    // the cycle has been detected
 			message.highestIdInKnot = highestID;
-			std::for_each(presentEdges.begin(), presentEdges.end(), [=](list<int> edge) {
-				if (edge.front() == id()) {
-					unicastTo(message, edge.back());
+			for (const EdgeRotation::Edge &edge : rotation.present()) {
+				if (edge.first == id()) {
+					unicastTo(message, edge.second);
 				}
-				});
+			}
 		}
 	}
 
 	// NOTE: If the total number of edges in the backbone topology, n, is not divisible by the number of allowed edges per state, m,
 	// then every [floor(n/m) + 1] rounds there will only be [n – (floor(n/m)*m)] edge(s).
 	void CycleOfTreesPeer::pickEdges() {
-
-		presentEdges.clear();
-
-		if (unusedEdges.empty()) {
-			unusedEdges = allEdges;
-		}
-
-		std::shuffle(unusedEdges.begin(), unusedEdges.end(), RANDOM_GENERATOR);
-
-		int i = 0;
-		auto it = unusedEdges.begin();
-		while (i < noOfEdges) {
-			if (it == unusedEdges.end()) {
-				break;
-			}
-
-			presentEdges.push_back(std::move(*it));
-			it = unusedEdges.erase(it);
-			++i;
-		}
+		rotation.next();
 	}
 
 	void CycleOfTreesPeer::setHighestID(int ID) {
@@ -13,6 +13,7 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <iostream>
 #include "../Common/Peer.hpp"
 #include "../Common/Simulation.hpp"
+#include "../Common/DynamicGraph.hpp"
 
 namespace quantas {
 
@@ -20,7 +21,6 @@ namespace quantas {
     using std::ostream;
     using std::vector;
     using std::set;
-    using std::list;
 
     struct CycleOfTreesMessage {
         set<int> nodesMessageHasReached = {};
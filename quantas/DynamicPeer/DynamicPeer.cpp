@@ -36,6 +36,13 @@ namespace quantas {
                 }
 	}
 
+	void DynamicPeer::updateParameters(const vector<Peer<DynamicMessage>*>& _peers, json parameters) {
+		const vector<DynamicPeer*> peers = reinterpret_cast<vector<DynamicPeer*> const&>(_peers);
+		for (DynamicPeer *peer : peers) {
+			peer->mineRate = parameters.value("mineRate", peer->mineRate);
+		}
+	}
+
 	void DynamicPeer::endOfRound(const vector<Peer<DynamicMessage>*>& _peers) {
 		const vector<DynamicPeer*> peers = reinterpret_cast<vector<DynamicPeer*> const&>(_peers);
 		bool  flag  = true;
@@ -30,6 +30,8 @@ namespace quantas {
 
     struct DynamicMessage {
         vector<DynamicBlock>         blockChain          {};        // sender's blockchain
+
+        void                         serialize           (Checkpoint &archive) { archive & blockChain; }
     };
 
     class DynamicPeer : public Peer<DynamicMessage> {
@@ -39,10 +41,16 @@ namespace quantas {
                              DynamicPeer        (const DynamicPeer& rhs);
                              ~DynamicPeer       ();
 
+        // initialize the configuration of the system
+        void                 initParameters     (const vector<Peer<DynamicMessage>*>& _peers, json parameters) { updateParameters(_peers, parameters); };
+        // set mineRate of every peer
+        void                 updateParameters   (const vector<Peer<DynamicMessage>*>& _peers, json parameters);
         // perform one step of the Algorithm with the messages in inStream
         void                 performComputation ();
         // perform any calculations needed at the end of a round such as determine throughput (only ran once, not for every peer)
         void                 endOfRound         (const vector<Peer<DynamicMessage>*>& _peers);
+        // saves or restores the peer for a checkpoint
+        void                 serialize          (Checkpoint &archive) { archive & blockChain & mineRate & acceptedBlocks; }
 
       
         // additional methods that have default implementation from Peer but can be overwritten
@@ -15,6 +15,7 @@ namespace quantas {
 
 	int EthereumPeer::currentTransaction = 1;
 	mutex EthereumPeer::currentTransaction_mutex;
+	Gauge EthereumPeer::throughput = Metrics::instance().gauge("throughput");
 
 	EthereumPeer::~EthereumPeer() {
 
@@ -58,7 +59,7 @@ namespace quantas {
 				index = i;
 			}
 		}
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["throughput"].push_back(length);
+		throughput.set(length);
 	}
 
 	void EthereumPeer::checkInStrm() {
@@ -196,6 +197,14 @@ namespace quantas {
 
 	}
 
+	size_t EthereumPeer::stateBytes()const {
+		size_t bytes = blockChain.capacity() * sizeof(vector<EtherBlock>);
+		for (const vector<EtherBlock>& chain : blockChain) {
+			bytes += chain.capacity() * sizeof(EtherBlock);
+		}
+		return bytes + (unlinkedBlocks.capacity() + transactions.capacity()) * sizeof(EtherBlock);
+	}
+
 	ostream& EthereumPeer::printTo(ostream& out)const {
 		Peer<EthereumPeerMessage>::printTo(out);
 
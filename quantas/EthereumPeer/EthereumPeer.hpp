@@ -60,6 +60,8 @@ namespace quantas{
         void                 log()const { printTo(*_log); };
         ostream&             printTo(ostream&)const;
         friend ostream& operator<<         (ostream&, const EthereumPeer&);
+        // bytes held by the blockchain and the blocks and transactions received, estimated from the vectors' capacities
+        size_t               stateBytes()const;
         
 
 
@@ -76,6 +78,8 @@ namespace quantas{
         // the id of the next transaction to submit
         static int            currentTransaction;
         static mutex          currentTransaction_mutex;
+        // transactions confirmed by the peer that has confirmed the fewest
+        static Gauge          throughput;
 
         // checkInStrm loops through the in stream adding blocks to unlinked or transactions
         void                  checkInStrm();
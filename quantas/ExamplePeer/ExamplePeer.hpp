@@ -26,6 +26,8 @@ namespace quantas{
         
         string aPeerId;
         string message;
+
+        void serialize(Checkpoint &archive) { archive & aPeerId & message; }
         
     };
 
@@ -43,6 +45,8 @@ namespace quantas{
         void                 performComputation ();
         // perform any calculations needed at the end of a round such as determine throughput (only ran once, not for every peer)
         void                 endOfRound         (const vector<Peer<ExampleMessage>*>& _peers);
+        // the peer keeps no state beyond its channels, so checkpoints need nothing more
+        void                 serialize          (Checkpoint &) {}
 
         // addintal method that have defulte implementation from Peer but can be overwritten
         void                 log()const { printTo(*_log); };
@@ -14,6 +14,9 @@ You should have received a copy of the GNU General Public License along with QUA
 namespace quantas {
 
 	int KademliaPeer::currentTransaction = 1;
+	Histogram KademliaPeer::hops = Metrics::instance().histogram("hops", false);
+	Counter KademliaPeer::latency = Metrics::instance().counter("latency", false);
+	Gauge KademliaPeer::averageHops = Metrics::instance().gauge("averageHops");
 
 	KademliaPeer::~KademliaPeer() {
 
@@ -63,9 +66,8 @@ namespace quantas {
 				KademliaMessage message = packet.getMessage();
 				if (message.action == "R") {
 					if (id() == message.reqId) {
-						requestsSatisfied++;
+						hops.record(message.hops);
 						latency += getRound() - message.roundSubmitted;
-						totalHops += message.hops;
 					}
 					else {
 						sendMessage(findRoute(message.binId), message);
@@ -78,13 +80,8 @@ namespace quantas {
 	void KademliaPeer::endOfRound(const vector<Peer<KademliaMessage>*>& _peers) {
 		const vector<KademliaPeer*> peers = reinterpret_cast<vector<KademliaPeer*> const&>(_peers);
 		peers[randMod(neighbors().size()) + 1]->submitTrans(currentTransaction);
-		double satisfied = 0;
-		double hops = 0;
-		for (int i = 0; i < peers.size(); i++) {
-			satisfied += peers[i]->requestsSatisfied;
-			hops += peers[i]->totalHops;
-		}
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["averageHops"].push_back(hops / satisfied);
+		// no request satisfied yet logs NaN, as the average of none
+		averageHops.set(hops.count() > 0 ? hops.mean() : std::nan(""));
 		
 	}
 
@@ -117,8 +114,7 @@ namespace quantas {
 		message.action = "R";
 		message.roundSubmitted = getRound();
 		if (id() == message.reqId) {
-			requestsSatisfied++;
-			totalHops += message.hops;
+			hops.record(message.hops);
 		}
 		else {
 			sendMessage(findRoute(message.binId), message);
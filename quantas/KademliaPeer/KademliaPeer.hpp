@@ -52,12 +52,11 @@ namespace quantas {
 		int	binaryIdSize;
 		// list of nodes list of nodes in different trees than current node
 		vector<KademliaFinger> fingers;
-		// number of requests satisfied
-		int requestsSatisfied = 0;
-		// total hops of all satisfied requests
-		int totalHops = 0;
+		// hops of every satisfied request, its count is the number of requests satisfied
+		static Histogram hops;
 		// latency of satisfied requests
-		int latency = 0;
+		static Counter latency;
+		static Gauge averageHops;
 		// status of node
 		bool alive = true;
 		// the binaryId of a node
@@ -8,11 +8,15 @@ You should have received a copy of the GNU General Public License along with QUA
 */
 
 #include <iostream>
+#include <cmath>
 #include "LinearChordPeer.hpp"
 
 namespace quantas {
 
 	int LinearChordPeer::currentTransaction = 1;
+	Histogram LinearChordPeer::hops = Metrics::instance().histogram("hops", false);
+	Counter LinearChordPeer::latency = Metrics::instance().counter("latency", false);
+	Gauge LinearChordPeer::averageHops = Metrics::instance().gauge("averageHops");
 	int LinearChordPeer::numberOfNodes = 0;
 
 	LinearChordPeer::~LinearChordPeer() {
@@ -58,16 +62,14 @@ namespace quantas {
 				long reqId = message.reqId;
 				if (message.action == "R") {
 					if (id() == reqId) {
-						requestsSatisfied++;
+						hops.record(message.hops);
 						latency += getRound() - message.roundSubmitted;
-						totalHops += message.hops;
 					}
 					else if (reqId > id()) {
 						if (successor.size() > 0) {
 							if (id() < reqId && (reqId < successor[0].Id || successor[0].Id < id())) {
-								requestsSatisfied++;
+								hops.record(message.hops);
 								latency += getRound() - message.roundSubmitted;
-								totalHops += message.hops;
 							}
 							else {
 								sendMessage(successor[0].Id, message);
@@ -209,13 +211,8 @@ namespace quantas {
 		const vector<LinearChordPeer*> peers = reinterpret_cast<vector<LinearChordPeer*> const&>(_peers);
 		numberOfNodes = peers.size();
 		peers[randMod(numberOfNodes)]->submitTrans(currentTransaction);
-		double satisfied = 0;
-		double hops = 0;
-		for (int i = 0; i < peers.size(); i++) {
-			satisfied += peers[i]->requestsSatisfied;
-			hops += peers[i]->totalHops;
-		}
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["averageHops"].push_back(hops / satisfied);
+		// no request satisfied yet logs NaN, as the average of none
+		averageHops.set(hops.count() > 0 ? hops.mean() : std::nan(""));
 	}
 
 	void LinearChordPeer::heartBeat() {
@@ -258,14 +255,12 @@ namespace quantas {
 		message.action = "R";
 		message.roundSubmitted = getRound();
 		if (id() == reqId) {
-			requestsSatisfied++;
-			totalHops += message.hops;
+			hops.record(message.hops);
 		}
 		else if (reqId > id()) {
 			if (successor.size() > 0) {
 				if (id() < reqId && (reqId < successor[0].Id || successor[0].Id < id())) {
-					requestsSatisfied++;
-					totalHops += message.hops;
+					hops.record(message.hops);
 				}
 				else {
 					sendMessage(successor[0].Id, message);
@@ -50,12 +50,11 @@ namespace quantas {
 		std::vector<LinearChordFinger> successor;
 		// list of nodes with 'lower' id than current node
 		std::vector<LinearChordFinger> predecessor;
-		// number of requests satisfied
-		int requestsSatisfied = 0;
-		// total hops of all satisfied requests
-		int totalHops = 0;
+		// hops of every satisfied request, its count is the number of requests satisfied
+		static Histogram hops;
 		// latency of satisfied requests
-		int latency = 0;
+		static Counter latency;
+		static Gauge averageHops;
 		// redundancy link number
 		int redundantSize = 2;
 		static int numberOfNodes;
@@ -8,11 +8,14 @@ You should have received a copy of the GNU General Public License along with QUA
 */
 
 #include <iostream>
+#include <cmath>
 #include "PBFTPeer.hpp"
 
 namespace quantas {
 
 	int PBFTPeer::currentTransaction = 1;
+	Histogram PBFTPeer::latency = Metrics::instance().histogram("latency", false);
+	Gauge PBFTPeer::averageLatency = Metrics::instance().gauge("latency");
 
 	PBFTPeer::~PBFTPeer() {
 
@@ -39,9 +42,8 @@ namespace quantas {
 	}
 
 	void PBFTPeer::endOfRound(const vector<Peer<PBFTPeerMessage>*>& _peers) {
-		const vector<PBFTPeer*> peers = reinterpret_cast<vector<PBFTPeer*> const&>(_peers);
-		double length = peers[0]->confirmedTrans.size();
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["latency"].push_back(latency / length);
+		// no transaction confirmed yet logs NaN, as the average of none
+		averageLatency.set(latency.count() > 0 ? latency.mean() : std::nan(""));
 	}
 
 	void PBFTPeer::checkInStrm() {
@@ -126,7 +128,7 @@ namespace quantas {
 			if (count > (neighbors().size() * 2 / 3)) {
 				status = "pre-prepare";
 				confirmedTrans.push_back(receivedMessages[sequenceNum][0]);
-				latency += getRound() - receivedMessages[sequenceNum][0].roundSubmitted;
+				latency.record(getRound() - receivedMessages[sequenceNum][0].roundSubmitted);
 				sequenceNum++;
 				if (id() == 0) {
 					submitTrans(currentTransaction);
@@ -148,6 +150,14 @@ namespace quantas {
 		currentTransaction++;
 	}
 
+	size_t PBFTPeer::stateBytes()const {
+		size_t bytes = receivedMessages.capacity() * sizeof(vector<PBFTPeerMessage>);
+		for (const vector<PBFTPeerMessage>& messages : receivedMessages) {
+			bytes += messages.capacity() * sizeof(PBFTPeerMessage);
+		}
+		return bytes + (transactions.capacity() + confirmedTrans.capacity()) * sizeof(PBFTPeerMessage);
+	}
+
 	ostream& PBFTPeer::printTo(ostream& out)const {
 		Peer<PBFTPeerMessage>::printTo(out);
 
@@ -41,6 +41,8 @@ namespace quantas{
         void                 log()const { printTo(*_log); };
         ostream&             printTo(ostream&)const;
         friend ostream& operator<<         (ostream&, const PBFTPeer&);
+        // bytes held by the messages and transactions received and confirmed, estimated from the vectors' capacities
+        size_t               stateBytes()const;
         
 
         // string indicating the current status of a node
@@ -53,8 +55,9 @@ namespace quantas{
         vector<PBFTPeerMessage>		    transactions;
         // vector of confirmed transactions
         vector<PBFTPeerMessage>		    confirmedTrans;
-        // latency of confirmed transactions
-        int                             latency = 0;
+        // latency of confirmed transactions, at every peer
+        static Histogram                latency;
+        static Gauge                    averageLatency;
         // rate at which to submit transactions ie 1 in x chance for all n nodes
         int                             submitRate = 20;
         
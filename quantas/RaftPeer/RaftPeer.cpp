@@ -8,11 +8,14 @@ You should have received a copy of the GNU General Public License along with QUA
 */
 
 #include <iostream>
+#include <cmath>
 #include "RaftPeer.hpp"
 
 namespace quantas {
 
 	int RaftPeer::currentTransaction = 1;
+	Histogram RaftPeer::latency = Metrics::instance().histogram("latency", false);
+	Gauge RaftPeer::averageLatency = Metrics::instance().gauge("latency");
 
 	RaftPeer::~RaftPeer() {
 
@@ -48,14 +51,8 @@ namespace quantas {
 	}
 
 	void RaftPeer::endOfRound(const vector<Peer<RaftPeerMessage>*>& _peers) {
-		const vector<RaftPeer*> peers = reinterpret_cast<vector<RaftPeer*> const&>(_peers);
-		double satisfied = 0;
-		double lat = 0;
-		for (int i = 0; i < peers.size(); i++) {
-			satisfied += peers[i]->requestsSatisfied;
-			lat += peers[i]->latency;
-		}
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["latency"].push_back(lat / satisfied);
+		// no request satisfied yet logs NaN, as the average of none
+		averageLatency.set(latency.count() > 0 ? latency.mean() : std::nan(""));
 	}
 
 	void RaftPeer::checkInStrm() {
@@ -79,8 +76,7 @@ namespace quantas {
 			else if (Msg.messageType == "respondRequest") {
 				replys[Msg.trans].push_back(Msg.Id);
 				if (replys[Msg.trans].size() == neighbors().size() / 2) {
-					requestsSatisfied++;
-					latency += getRound() - Msg.roundSubmitted;
+					latency.record(getRound() - Msg.roundSubmitted);
 					submitTrans(currentTransaction);
 				}
 			}
@@ -145,6 +141,14 @@ namespace quantas {
 		pushToOutSteam(newMessage);
 	}
 
+	size_t RaftPeer::stateBytes()const {
+		size_t bytes = votes.capacity() * sizeof(int);
+		for (const auto& reply : replys) {
+			bytes += sizeof(reply) + 4 * sizeof(void*) + reply.second.capacity() * sizeof(int);
+		}
+		return bytes;
+	}
+
 	ostream& RaftPeer::printTo(ostream& out)const {
 		Peer<RaftPeerMessage>::printTo(out);
 
@@ -41,15 +41,16 @@ namespace quantas{
         void                 log()const { printTo(*_log); };
         ostream&             printTo(ostream&)const;
         friend ostream& operator<<         (ostream&, const RaftPeer&);
+        // bytes held by the votes and replies, a map node taking four pointers besides its value, estimated from the vectors' capacities
+        size_t               stateBytes()const;
         
         // id of the node voted as the next leader
         int                             candidate = -1;
         // the id of the next transaction to submit
         static int                      currentTransaction;
-        // number of requests satisfied
-        int                             requestsSatisfied = 0;
-        // latency of satisfied requests
-        int                             latency = 0;
+        // latency of satisfied requests, its count is the number of requests satisfied
+        static Histogram                latency;
+        static Gauge                    averageLatency;
         // number of rounds to add to timeouts
         const static int                timeOutSpacing = 100;
         // max number of random rounds to add to timeouts 0 - (timeOutRandom - 1)
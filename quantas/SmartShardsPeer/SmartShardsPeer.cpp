@@ -18,6 +18,11 @@ namespace quantas {
 	int SmartShardsPeer::churnRate = 0;
 	int SmartShardsPeer::maxLeaveDelay = 100;
 	int SmartShardsPeer::ChurnOption = 0;
+	Counter SmartShardsPeer::latency = Metrics::instance().counter("Latency", false);
+	Counter SmartShardsPeer::messagesSent = Metrics::instance().counter("NumberOfMessages", false);
+	Gauge SmartShardsPeer::throughput = Metrics::instance().gauge("Throughput");
+	Gauge SmartShardsPeer::joinWaiting = Metrics::instance().gauge("joinWaiting");
+	Gauge SmartShardsPeer::leaveWaiting = Metrics::instance().gauge("leaveWaiting");
 
 	template <typename Map>
 	bool key_compare(Map const& lhs, Map const& rhs) {
@@ -123,6 +128,10 @@ namespace quantas {
 			}
 		}
 
+		updateParameters(_peers, parameters);
+	}
+
+	void SmartShardsPeer::updateParameters(const vector<Peer<SmartShardsMessage>*>& _peers, json parameters) {
 		if (parameters.contains("churnRate")) {
 			churnRate = parameters["churnRate"];
 		}
@@ -225,16 +234,12 @@ namespace quantas {
 		if (lastRound()) {
 			// doubles for division
 			double length = 0;
-			double totalMessages = 0;
-			double totalLatency = 0;
 			double joinTime = 0;
 			double nodesJoined = 0;
 			double leaveTime = 0;
 			double nodesLeftSuccessfully = 0;
 			for (int i = 0; i < peers.size(); i++) {
 				length += peers[i]->confirmedTrans.size();
-				totalMessages += peers[i]->messagesSent;
-				totalLatency += peers[i]->latency;
 				joinTime += peers[i]->timeToJoin;
 				if (peers[i]->timeToJoin != 0) {
 					nodesJoined++;
@@ -244,15 +249,13 @@ namespace quantas {
 					nodesLeftSuccessfully++;
 				}
 			}
-			//LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["NumberOfMessages"].push_back(totalMessages);
-			LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["Throughput"].push_back(length);
+			throughput.set(length);
 			if (nodesJoined != 0) {
-				LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["joinWaiting"].push_back(joinTime / nodesJoined);
+				joinWaiting.set(joinTime / nodesJoined);
 			}
 			if (nodesLeftSuccessfully != 0) {
-				LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["leaveWaiting"].push_back(leaveTime / nodesLeftSuccessfully);
+				leaveWaiting.set(leaveTime / nodesLeftSuccessfully);
 			}
-			//LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["Latency"].push_back(totalLatency / length);
 		}
 	}
 
@@ -53,6 +53,8 @@ namespace quantas {
 
         // initialize the configuration of the system
         void                 initParameters(const vector<Peer<SmartShardsMessage>*>& _peers, json parameters);
+        // change the churn settings
+        void                 updateParameters(const vector<Peer<SmartShardsMessage>*>& _peers, json parameters);
         // perform one step of the Algorithm with the messages in inStream
         void                 performComputation();
         // perform any calculations needed at the end of a round such as determine throughput (only ran once, not for every peer)
@@ -88,8 +90,11 @@ namespace quantas {
         // vector of confirmed transactions
         vector<SmartShardsMessage>		    confirmedTrans;
         // Various metrics
-        int                             latency = 0;
-        int                             messagesSent = 0;
+        static Counter                  latency;
+        static Counter                  messagesSent;
+        static Gauge                    throughput;
+        static Gauge                    joinWaiting;
+        static Gauge                    leaveWaiting;
         int                             timeToJoin = 0;
         int                             timeToLeave = 0;
         // transaction currently being processed in a specific shard
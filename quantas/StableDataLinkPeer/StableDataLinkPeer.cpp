@@ -13,6 +13,9 @@ You should have received a copy of the GNU General Public License along with QUA
 namespace quantas {
 
 	int StableDataLinkPeer::currentTransaction = 1;
+	Counter StableDataLinkPeer::requestsSatisfied = Metrics::instance().counter("requestsSatisfied", false);
+	Counter StableDataLinkPeer::messagesSent = Metrics::instance().counter("messagesSent", false);
+	Gauge StableDataLinkPeer::utility = Metrics::instance().gauge("utility");
 
 	StableDataLinkPeer::~StableDataLinkPeer() {
 
@@ -80,14 +83,7 @@ namespace quantas {
 	}
 
 	void StableDataLinkPeer::endOfRound(const vector<Peer<StableDataLinkMessage>*>& _peers) {
-		const vector<StableDataLinkPeer*> peers = reinterpret_cast<vector<StableDataLinkPeer*> const&>(_peers);
-		int satisfied = 0;
-		double messages = 0;
-		for (int i = 0; i < peers.size(); i++) {
-			satisfied += peers[i]->requestsSatisfied;
-			messages += peers[i]->messagesSent;
-		}
-		LogWriter::instance()->data["tests"][LogWriter::instance()->getTest()]["utility"].push_back(satisfied / messages * 100);
+		utility.set(requestsSatisfied.value() / double(messagesSent.value()) * 100);
 	}
 
 	void StableDataLinkPeer::sendMessage(long peer, StableDataLinkMessage message) {
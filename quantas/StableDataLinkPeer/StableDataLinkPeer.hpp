@@ -44,9 +44,11 @@ namespace quantas {
 		// channel size (non fifo channels not implemented channel size limit not implemented)
 		int c = 1;
 		// number of requests satisfied
-		int requestsSatisfied = 0;
+		static Counter                  requestsSatisfied;
 		// number of messages sent
-		int messagesSent = 0;
+		static Counter                  messagesSent;
+		// percentage of the messages sent that satisfied a request
+		static Gauge                    utility;
 		// number of copies recieved
 		int ack = 0;
 		// num / den = likelyhood of message getting lost
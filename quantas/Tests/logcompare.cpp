@@ -0,0 +1,70 @@
+// Compares the series (the values logged every round) of one test of two logs, e.g. of a run and
+// of the run restored from its checkpoint, which must be the same.
+//
+// usage: logcompare.exe first.txt second.txt test
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "../Common/Json.hpp"
+
+using nlohmann::json;
+
+bool readLog(const char *file, json &log)
+{
+    std::ifstream in(file);
+    log = json::parse(in, nullptr, false);
+    if (log.is_discarded())
+    {
+        std::cerr << "error: cannot read log " << file << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, const char *argv[])
+{
+    if (argc < 4)
+    {
+        std::cerr << "usage: " << argv[0] << " first.txt second.txt test" << std::endl;
+        return 1;
+    }
+    json first, second;
+    if (!readLog(argv[1], first) || !readLog(argv[2], second))
+    {
+        return 1;
+    }
+    size_t test = std::stoul(argv[3]);
+    if (!first.contains("tests") || !second.contains("tests") || first["tests"].size() <= test || second["tests"].size() <= test)
+    {
+        std::cerr << "error: the logs do not both have test " << test << std::endl;
+        return 1;
+    }
+    const json &a = first["tests"][test];
+    const json &b = second["tests"][test];
+    int series = 0;
+    int different = 0;
+    for (auto it = a.begin(); it != a.end(); ++it)
+    {
+        if (!it.value().is_array())
+        {
+            continue;
+        }
+        series++;
+        if (!b.contains(it.key()) || b[it.key()] != it.value())
+        {
+            std::cerr << "error: series " << it.key() << " differs" << std::endl;
+            different++;
+        }
+    }
+    for (auto it = b.begin(); it != b.end(); ++it)
+    {
+        if (it.value().is_array() && !a.contains(it.key()))
+        {
+            std::cerr << "error: series " << it.key() << " is only in " << argv[2] << std::endl;
+            different++;
+        }
+    }
+    std::cout << series << " series compared, " << different << " differ" << std::endl;
+    return different == 0 && series > 0 ? 0 : 1;
+}
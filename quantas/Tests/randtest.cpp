@@ -2,6 +2,8 @@
 #include <thread>
 #include <vector>
 #include <cassert>
+#include <cmath>
+#include <random>
 #include "../Common/Distribution.hpp"
 
 void getRandomInts(std::vector<int> &randomInts, int howMany)
@@ -12,6 +14,47 @@ void getRandomInts(std::vector<int> &randomInts, int howMany)
     }
 }
 
+// draws samples delays from a distribution set to settings, checks that they are all in [low, high]
+// and that their mean is within tolerance of mean
+void checkDelays(const nlohmann::json &settings, int low, int high, double mean, double tolerance)
+{
+    const int Samples = 200000;
+    quantas::Distribution distribution;
+    distribution.setDistribution(settings);
+    std::mt19937_64 generator(42);
+    double sum = 0;
+    for (int i = 0; i < Samples; i++)
+    {
+        int delay = distribution.getDelay(generator);
+        assert(delay >= low && delay <= high);
+        sum += delay;
+    }
+    std::cout << settings.dump() << " mean " << sum / Samples << std::endl;
+    assert(std::abs(sum / Samples - mean) <= tolerance);
+}
+
+void checkDistributions()
+{
+    // an alias table never draws an index of weight 0, and draws the others in proportion
+    quantas::AliasTable table({1, 0, 3});
+    std::mt19937_64 generator(7);
+    int counts[3] = {0, 0, 0};
+    for (int i = 0; i < 100000; i++)
+    {
+        counts[table.sample(generator)]++;
+    }
+    assert(counts[1] == 0);
+    assert(std::abs(counts[2] / 100000.0 - 0.75) < 0.01);
+
+    checkDelays({{"type", "UNIFORM"}, {"minDelay", 3}, {"maxDelay", 7}}, 3, 7, 5, 0.02);
+    // a Poisson distribution truncated to [1, maxDelay] has the mean of one conditioned on k >= 1
+    checkDelays({{"type", "POISSON"}, {"avgDelay", 5}, {"maxDelay", 100}}, 1, 100, 5 / (1 - std::exp(-5.0)), 0.02);
+    checkDelays({{"type", "POISSON"}, {"avgDelay", 5}, {"minDelay", 4}, {"maxDelay", 6}}, 4, 6, 84.0 / 17, 0.02);
+    checkDelays({{"type", "EMPIRICAL"}, {"histogram", {{2, 1}, {5, 3}}}}, 2, 5, 4.25, 0.02);
+    checkDelays({{"type", "EMPIRICAL"}, {"histogram", {{2, 1}, {5, 3}}}, {"maxDelay", 4}}, 2, 2, 2, 0);
+    checkDelays({{"type", "ONE"}, {"maxDelay", 10}}, 1, 1, 1, 0);
+}
+
 int main()
 {
     const int RandIntCount = 10;
@@ -46,5 +89,7 @@ int main()
         }
     }
 
+    checkDistributions();
+
     return 0;
 }
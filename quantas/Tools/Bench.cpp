@@ -0,0 +1,239 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Runs simulators built for different algorithms at several scales and topologies and writes how
+// fast they ran into a json file, for make bench. Each algorithm is given as name:exe:input, the
+// first experiment of input being the one run, with its topology, rounds and tests replaced. Each
+// run is a process of its own, from which the wall-clock and peak resident memory are taken; the
+// simulator's log gives its RunTime, StartupTime (until the first round) and Packets sent.
+//
+// usage: bench.exe results.json [--rounds 20] [--scales 100,1000] [--topologies ring,complete,torus]
+//            [--threads N] [--timeout seconds] [--completeMax peers] [--dir runs] [--version v] name:exe:input...
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <ctime>
+#include <csignal>
+#include <chrono>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "../Common/Json.hpp"
+
+using std::string;
+using std::vector;
+using nlohmann::json;
+
+static vector<string> split(const string &list, char separator) {
+    vector<string> items;
+    std::istringstream stream(list);
+    string item;
+    while (std::getline(stream, item, separator)) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// the topology of the experiment for peers peers, a torus being as square as peers allows
+static json topology(const string &type, int peers) {
+    json topology = {{"type", type}, {"initialPeers", peers}, {"totalPeers", peers}};
+    if (type == "torus" || type == "grid") {
+        int height = static_cast<int>(std::sqrt(double(peers)));
+        while (peers % height != 0) {
+            height--;
+        }
+        topology["height"] = height;
+        topology["width"] = peers / height;
+    }
+    return topology;
+}
+
+// runs exe on input with the simulator's output discarded, killing it after timeout seconds
+static json run(const string &exe, const string &input, int timeout) {
+    json result;
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        result["error"] = "cannot fork";
+        return result;
+    }
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        if (timeout > 0) {
+            alarm(timeout); // kept across exec
+        }
+        execl(exe.c_str(), exe.c_str(), input.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    result["wallSeconds"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result["peakRssKB"] = usage.ru_maxrss;
+    if (WIFSIGNALED(status)) {
+        result["error"] = WTERMSIG(status) == SIGALRM ? string("timeout") : "killed by signal " + std::to_string(WTERMSIG(status));
+    }
+    else if (WEXITSTATUS(status) != 0) {
+        result["error"] = "exit status " + std::to_string(WEXITSTATUS(status));
+    }
+    return result;
+}
+
+int main(int argc, const char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " results.json [--rounds 20] [--scales 100,1000] [--topologies ring,torus] [--threads N] [--timeout seconds] [--completeMax peers] [--dir runs] [--version v] name:exe:input..." << std::endl;
+        return 1;
+    }
+    int rounds = 20;
+    vector<int> scales = {100, 1000, 10000, 100000};
+    vector<string> topologies = {"ring", "complete", "torus"};
+    int threads = 0;
+    int timeout = 600;
+    int completeMax = 1000;
+    string dir = "bench";
+    string version;
+    vector<vector<string>> algorithms;
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--rounds" && i + 1 < argc) {
+            rounds = std::stoi(argv[++i]);
+        }
+        else if (option == "--scales" && i + 1 < argc) {
+            scales.clear();
+            for (const string &scale : split(argv[++i], ',')) {
+                scales.push_back(std::stoi(scale));
+            }
+        }
+        else if (option == "--topologies" && i + 1 < argc) {
+            topologies = split(argv[++i], ',');
+        }
+        else if (option == "--threads" && i + 1 < argc) {
+            threads = std::stoi(argv[++i]);
+        }
+        else if (option == "--timeout" && i + 1 < argc) {
+            timeout = std::stoi(argv[++i]);
+        }
+        else if (option == "--completeMax" && i + 1 < argc) {
+            completeMax = std::stoi(argv[++i]);
+        }
+        else if (option == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        }
+        else if (option == "--version" && i + 1 < argc) {
+            version = argv[++i];
+        }
+        else if (split(option, ':').size() == 3) {
+            algorithms.push_back(split(option, ':'));
+        }
+        else {
+            std::cerr << "error: unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+    mkdir(dir.c_str(), 0755);
+
+    json results;
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    results["version"] = version;
+    results["date"] = date;
+    results["host"] = host;
+    results["cores"] = std::thread::hardware_concurrency();
+    results["rounds"] = rounds;
+    results["runs"] = json::array();
+
+    for (const vector<string> &algorithm : algorithms) {
+        std::ifstream inFile(algorithm[2]);
+        json experiment;
+        try {
+            inFile >> experiment;
+            experiment = experiment.at("experiments").at(0);
+        }
+        catch (const std::exception&) {
+            std::cerr << "error: cannot read an experiment from " << algorithm[2] << std::endl;
+            continue;
+        }
+        // only the simulation itself is timed
+        for (const char *key : {"metrics", "trace", "profile", "costs", "memory", "queues", "traffic", "latency", "perfCounters", "checkpoint", "restore", "branch"}) {
+            experiment.erase(key);
+        }
+        experiment["rounds"] = rounds;
+        experiment["tests"] = 1;
+        if (threads > 0) {
+            experiment["threadCount"] = threads;
+        }
+
+        for (const string &type : topologies) {
+            for (int peers : scales) {
+                if (type == "complete" && peers > completeMax) {
+                    continue;
+                }
+                string name = dir + "/" + algorithm[0] + "." + type + "." + std::to_string(peers);
+                experiment["topology"] = topology(type, peers);
+                experiment["logFile"] = name + ".log.json";
+                std::ofstream(name + ".json") << json({{"experiments", json::array({experiment})}}).dump(2);
+                std::remove((name + ".log.json").c_str());
+
+                json result = run(algorithm[1], name + ".json", timeout);
+                json log;
+                std::ifstream logFile(name + ".log.json");
+                if (!result.contains("error") && !(logFile >> log)) {
+                    result["error"] = string("no log");
+                }
+                if (!result.contains("error")) {
+                    double runTime = log.value("RunTime", 0.0);
+                    double startup = log.value("StartupTime", 0.0);
+                    double simulated = std::max(runTime - startup, 1e-9);
+                    result["runSeconds"] = runTime;
+                    result["startupSeconds"] = startup;
+                    result["roundsPerSecond"] = rounds / simulated;
+                    result["packets"] = log.value("Packets", uint64_t(0));
+                    result["packetsPerSecond"] = log.value("Packets", uint64_t(0)) / simulated;
+                }
+                result["algorithm"] = algorithm[0];
+                result["topology"] = type;
+                result["peers"] = peers;
+                result["threadCount"] = experiment.value("threadCount", 0);
+                results["runs"].push_back(result);
+
+                std::cout << algorithm[0] << " " << type << " " << peers << ": ";
+                if (result.contains("error")) {
+                    std::cout << result["error"].get<string>();
+                }
+                else {
+                    std::cout << result["roundsPerSecond"].get<double>() << " rounds/s, " << result["packetsPerSecond"].get<double>() << " packets/s, "
+                              << result["peakRssKB"].get<long>() << " KB, startup " << result["startupSeconds"].get<double>() << " s";
+                }
+                std::cout << std::endl;
+                // written after every run, so an interrupted suite keeps what it measured
+                std::ofstream(argv[1]) << results.dump(2) << std::endl;
+            }
+        }
+    }
+    std::ofstream outFile(argv[1]);
+    if (outFile.fail()) {
+        std::cerr << "error: cannot open output file" << std::endl;
+        return 1;
+    }
+    outFile << results.dump(2) << std::endl;
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Converts a text list of topology changes into the binary trace read by a topology's "trace".
+//
+// Each line of the input holds one change "round op source target", where op is + (or add) to add
+// the directed edge from source to target at the start of round, and - (or remove) to remove it.
+// Blank lines and lines starting with '#' or '%' are skipped. Changes are sorted by round and
+// source; changes to the same edge within a round keep their order.
+//
+// usage: deltaListToTrace.exe input.txt output.trace [--undirected]
+//   --undirected   also apply every change to the reverse edge
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../Common/TopologyTrace.hpp"
+
+using std::string;
+using std::vector;
+using quantas::TopologyEvent;
+
+int main(int argc, const char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " input.txt output.trace [--undirected]" << std::endl;
+        return 1;
+    }
+    bool undirected = false;
+    for (int i = 3; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--undirected") {
+            undirected = true;
+        }
+        else {
+            std::cerr << "error: unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream inFile(argv[1]);
+    if (inFile.fail()) {
+        std::cerr << "error: cannot open input file" << std::endl;
+        return 1;
+    }
+
+    vector<TopologyEvent> events;
+    string line;
+    int lineNumber = 0;
+    while (std::getline(inFile, line)) {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#' || line[0] == '%') {
+            continue;
+        }
+        std::istringstream fields(line);
+        string op;
+        TopologyEvent event;
+        if (!(fields >> event.round >> op >> event.source >> event.target)) {
+            std::cerr << "error: cannot read line " << lineNumber << std::endl;
+            return 1;
+        }
+        if (op == "+" || op == "add") {
+            event.op = TopologyEvent::ADD_EDGE;
+        }
+        else if (op == "-" || op == "remove") {
+            event.op = TopologyEvent::REMOVE_EDGE;
+        }
+        else {
+            std::cerr << "error: unknown change " << op << " on line " << lineNumber << std::endl;
+            return 1;
+        }
+        events.push_back(event);
+        if (undirected) {
+            std::swap(event.source, event.target);
+            events.push_back(event);
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const TopologyEvent &a, const TopologyEvent &b) {
+        return a.round != b.round ? a.round < b.round : a.source < b.source;
+    });
+
+    try {
+        quantas::TopologyTrace::write(argv[2], events);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << events.size() << " changes over " << (events.empty() ? 0 : events.back().round + 1) << " rounds" << std::endl;
+    return 0;
+}
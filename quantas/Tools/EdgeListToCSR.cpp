@@ -0,0 +1,152 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Converts a text edge list into the binary CSR file read by the "edgeFile" topology.
+//
+// Each line of the input holds one directed edge "source target [delay [class]]". Blank lines and
+// lines starting with '#' or '%' are skipped. Every row of the output is sorted and duplicate edges
+// are dropped (the first delay given wins). If any edge has a delay, edges without one are written
+// with delay 0, meaning the channel delay is drawn from its distribution. The class k > 0 selects
+// the k-th of the distribution's "channels" for the edge, 0 (the default) the distribution itself.
+//
+// usage: edgeListToCSR.exe input.txt output.csr [--undirected] [--nodes N]
+//   --undirected   also add the reverse of every edge
+//   --nodes N      number of nodes, by default one more than the largest id seen
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../Common/EdgeFile.hpp"
+
+using std::string;
+using std::vector;
+
+int main(int argc, const char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " input.txt output.csr [--undirected] [--nodes N]" << std::endl;
+        return 1;
+    }
+    bool undirected = false;
+    uint64_t nodes = 0;
+    for (int i = 3; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--undirected") {
+            undirected = true;
+        }
+        else if (option == "--nodes" && i + 1 < argc) {
+            nodes = std::stoull(argv[++i]);
+        }
+        else {
+            std::cerr << "error: unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream inFile(argv[1]);
+    if (inFile.fail()) {
+        std::cerr << "error: cannot open input file" << std::endl;
+        return 1;
+    }
+
+    vector<uint32_t> sources, targets;
+    vector<uint16_t> delays, classes;
+    bool anyDelay = false;
+    bool anyClass = false;
+    string line;
+    while (std::getline(inFile, line)) {
+        if (line.empty() || line[0] == '#' || line[0] == '%') {
+            continue;
+        }
+        std::istringstream fields(line);
+        uint64_t source, target, delay = 0, delayClass = 0;
+        if (!(fields >> source >> target)) {
+            continue;
+        }
+        if (fields >> delay) {
+            anyDelay = anyDelay || delay != 0;
+            if (fields >> delayClass) {
+                anyClass = true;
+            }
+        }
+        sources.push_back((uint32_t)source);
+        targets.push_back((uint32_t)target);
+        delays.push_back((uint16_t)std::min<uint64_t>(delay, UINT16_MAX));
+        classes.push_back((uint16_t)std::min<uint64_t>(delayClass, UINT16_MAX));
+        if (undirected) {
+            sources.push_back((uint32_t)target);
+            targets.push_back((uint32_t)source);
+            delays.push_back(delays.back());
+            classes.push_back(classes.back());
+        }
+        nodes = std::max<uint64_t>(nodes, std::max(source, target) + 1);
+    }
+
+    // counting sort by source, then sort and deduplicate every row
+    vector<uint64_t> offsets(nodes + 1, 0);
+    for (uint32_t source : sources) {
+        if (source < nodes) {
+            offsets[source + 1]++;
+        }
+    }
+    for (uint64_t i = 0; i < nodes; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    vector<uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+    struct Edge {
+        uint32_t    target;
+        uint16_t    delay;
+        uint16_t    delayClass;
+    };
+    vector<Edge> edges(offsets[nodes]);
+    for (size_t e = 0; e < sources.size(); e++) {
+        if (sources[e] < nodes) {
+            edges[cursor[sources[e]]++] = {targets[e], delays[e], classes[e]};
+        }
+    }
+    sources.clear();
+    sources.shrink_to_fit();
+
+    targets.clear();
+    delays.clear();
+    classes.clear();
+    vector<uint64_t> rows(nodes + 1, 0);
+    for (uint64_t i = 0; i < nodes; i++) {
+        auto first = edges.begin() + offsets[i];
+        auto last = edges.begin() + offsets[i + 1];
+        std::stable_sort(first, last, [](const Edge &a, const Edge &b) { return a.target < b.target; });
+        for (auto it = first; it != last; ++it) {
+            if (it != first && it->target == (it - 1)->target) {
+                continue;
+            }
+            targets.push_back(it->target);
+            delays.push_back(it->delay);
+            classes.push_back(it->delayClass);
+        }
+        rows[i + 1] = targets.size();
+    }
+    if (!anyDelay) {
+        delays.clear();
+    }
+    if (!anyClass) {
+        classes.clear();
+    }
+
+    try {
+        quantas::EdgeFile::write(argv[2], rows, targets, delays, classes);
+    }
+    catch (const std::exception &e) {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << nodes << " nodes, " << targets.size() << " edges" << (anyDelay ? " with delays" : "") << (anyClass ? " with classes" : "") << std::endl;
+    return 0;
+}
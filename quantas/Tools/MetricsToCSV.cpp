@@ -0,0 +1,95 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Converts a binary metrics file, written by a run with "metrics": {"format": "binary"}, into the
+// csv the "csv" format writes.
+//
+// usage: metricsToCSV.exe input.qmet output.csv
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../Common/MetricsWriter.hpp"
+
+using std::string;
+using std::vector;
+using quantas::MetricsWriter;
+
+int main(int argc, const char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " input.qmet output.csv" << std::endl;
+        return 1;
+    }
+
+    std::ifstream inFile(argv[1], std::ios::binary);
+    if (inFile.fail()) {
+        std::cerr << "error: cannot open input file" << std::endl;
+        return 1;
+    }
+    uint32_t header[2];
+    if (!inFile.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != MetricsWriter::MAGIC || header[1] != MetricsWriter::VERSION) {
+        std::cerr << "error: " << argv[1] << " is not a QUANTAS metrics file" << std::endl;
+        return 1;
+    }
+
+    std::ofstream outFile(argv[2]);
+    if (outFile.fail()) {
+        std::cerr << "error: cannot open output file" << std::endl;
+        return 1;
+    }
+    outFile << "test,round,metric,value\n";
+
+    vector<string> names;
+    uint32_t block[2];
+    size_t rows = 0;
+    while (inFile.read(reinterpret_cast<char*>(block), sizeof(block))) {
+        uint32_t count = block[1];
+        if (block[0] == MetricsWriter::NAMES) {
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t entry[2];
+                inFile.read(reinterpret_cast<char*>(entry), sizeof(entry));
+                string name(entry[1], '\0');
+                inFile.read(&name[0], entry[1]);
+                if (names.size() <= entry[0]) {
+                    names.resize(entry[0] + 1);
+                }
+                names[entry[0]] = name;
+            }
+        }
+        else if (block[0] == MetricsWriter::ROWS) {
+            vector<int32_t> tests(count), rounds(count);
+            vector<uint32_t> metrics(count);
+            vector<double> values(count);
+            inFile.read(reinterpret_cast<char*>(tests.data()), count * sizeof(int32_t));
+            inFile.read(reinterpret_cast<char*>(rounds.data()), count * sizeof(int32_t));
+            inFile.read(reinterpret_cast<char*>(metrics.data()), count * sizeof(uint32_t));
+            inFile.read(reinterpret_cast<char*>(values.data()), count * sizeof(double));
+            if (!inFile) {
+                break;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                const string &name = metrics[i] < names.size() ? names[metrics[i]] : std::to_string(metrics[i]);
+                outFile << tests[i] << "," << rounds[i] << "," << MetricsWriter::csvField(name) << "," << MetricsWriter::number(values[i]) << "\n";
+            }
+            rows += count;
+        }
+        else {
+            std::cerr << "error: unknown block " << block[0] << std::endl;
+            return 1;
+        }
+    }
+    if (!inFile.eof()) {
+        std::cerr << "error: " << argv[1] << " is truncated" << std::endl;
+        return 1;
+    }
+
+    std::cout << rows << " rows" << std::endl;
+    return 0;
+}
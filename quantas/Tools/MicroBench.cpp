@@ -0,0 +1,306 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Times the primitives of NetworkInterface on their own: broadcast, broadcastBut, unicastTo,
+// randomMulticast, transmit, receive and popInStream, for a peer with 4 to 256 neighbors, messages
+// of 16 to 2048 bytes and, for transmit and receive, a few delay distributions. The peer is the
+// center of a star of interfaces wired as the network wires them. Calls are timed in short runs, with the state they
+// need set up and cleaned up around each run untimed, and the clock's own cost taken off.
+//
+// A benchmark takes samples of enough runs to last --minTime ms each, at least --samples of them,
+// and more until the 95% confidence interval of the mean is within 2% of it or --maxSamples are
+// taken. The report gives nanoseconds per call (per packet for popInStream).
+//
+// usage: microbench.exe [report.json] [--samples 10] [--maxSamples 30] [--minTime 1]
+//            [--neighbors 4,32,256] [--filter name]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include "../Common/Peer.hpp"
+#include "../Common/Json.hpp"
+
+using std::string;
+using std::vector;
+using nlohmann::json;
+using namespace quantas;
+
+typedef std::chrono::steady_clock Clock;
+
+// what the packets popped are added to, so that popping them is not optimized away
+volatile long sink = 0;
+
+// a message of BYTES bytes of plain data
+template<size_t BYTES>
+struct Payload {
+    char bytes[BYTES];
+};
+
+// a peer calling the primitives of its interface from outside
+template<class message>
+class BenchPeer : public Peer<message> {
+public:
+    BenchPeer                                   (long id) : Peer<message>(id) {};
+    void                    performComputation  () override {};
+    using NetworkInterface<message>::broadcast;
+    using NetworkInterface<message>::broadcastBut;
+    using NetworkInterface<message>::unicastTo;
+    using NetworkInterface<message>::randomMulticast;
+};
+
+struct Options {
+    int                     samples = 10;
+    int                     maxSamples = 30;
+    double                  minTime = 1e6;  // nanoseconds
+    vector<int>             neighbors = {4, 32, 256};
+    string                  filter;
+};
+
+static double clockOverhead() {
+    vector<int64_t> costs(1000);
+    for (int64_t &cost : costs) {
+        Clock::time_point start = Clock::now();
+        cost = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+    std::sort(costs.begin(), costs.end());
+    return double(costs[costs.size() / 2]);
+}
+
+// a primitive and the calls of it timed in one run, setup and cleanup being called around the run
+struct Benchmark {
+    string                  name;
+    std::function<void()>   setup;
+    std::function<void()>   op;
+    std::function<void()>   cleanup;
+    int                     callsPerRun;
+    int                     perCall;        // what a call is divided into, e.g. the packets popped
+};
+
+// summarizes the time of a call of benchmark's op
+static json measure(const Options &options, double overhead, const Benchmark &benchmark) {
+    auto sample = [&](long runs) {
+        double total = 0;
+        for (long r = 0; r < runs; r++) {
+            benchmark.setup();
+            Clock::time_point start = Clock::now();
+            for (int c = 0; c < benchmark.callsPerRun; c++) {
+                benchmark.op();
+            }
+            Clock::time_point end = Clock::now();
+            benchmark.cleanup();
+            total += std::max(0.0, std::chrono::duration<double, std::nano>(end - start).count() - overhead);
+        }
+        return total;
+    };
+    // calibrate the runs of a sample, also warming up, unless setting them up takes far longer
+    long runs = 1;
+    while (runs < (1L << 24)) {
+        Clock::time_point start = Clock::now();
+        if (sample(runs) >= options.minTime || std::chrono::duration<double, std::nano>(Clock::now() - start).count() >= 20 * options.minTime) {
+            break;
+        }
+        runs *= 2;
+    }
+    vector<double> perOp;
+    double mean = 0, stddev = 0, ci = 0;
+    while (true) {
+        perOp.push_back(sample(runs) / runs / benchmark.callsPerRun / benchmark.perCall);
+        size_t n = perOp.size();
+        mean = 0;
+        for (double value : perOp) {
+            mean += value;
+        }
+        mean /= n;
+        stddev = 0;
+        for (double value : perOp) {
+            stddev += (value - mean) * (value - mean);
+        }
+        stddev = n > 1 ? std::sqrt(stddev / (n - 1)) : 0;
+        ci = n > 1 ? 1.96 * stddev / std::sqrt(double(n)) : mean;
+        if ((int)n >= options.maxSamples || ((int)n >= options.samples && ci <= 0.02 * mean)) {
+            break;
+        }
+    }
+    vector<double> sorted = perOp;
+    std::sort(sorted.begin(), sorted.end());
+    json result;
+    result["median"] = sorted[sorted.size() / 2];
+    result["mean"] = mean;
+    result["stddev"] = stddev;
+    result["ci95"] = ci;
+    result["min"] = sorted.front();
+    result["max"] = sorted.back();
+    result["samples"] = perOp.size();
+    result["callsPerSample"] = runs * benchmark.callsPerRun;
+    result["stable"] = ci <= 0.02 * mean;
+    return result;
+}
+
+// the benchmarks of messages of BYTES bytes for a peer with each number of neighbors and each distribution
+static const int FILL_ROUNDS = 16;
+
+template<size_t BYTES>
+static void run(const Options &options, double overhead, json &results) {
+    typedef Payload<BYTES> message;
+    static const vector<std::pair<string, json>> distributions = {
+        {"uniform1", {{"type", "UNIFORM"}, {"maxDelay", 1}}},
+        {"uniform10", {{"type", "UNIFORM"}, {"maxDelay", 10}}},
+        {"poisson5", {{"type", "POISSON"}, {"avgDelay", 5}, {"maxDelay", 20}}}
+    };
+    for (int k : options.neighbors) {
+        for (const auto &distribution : distributions) {
+            // peer 0 is the center of a star of k peers
+            DelayTable delays;
+            delays.setDistribution(distribution.second);
+            vector<std::unique_ptr<BenchPeer<message>>> peers;
+            vector<NetworkInterface<message>*> directory;
+            for (int i = 0; i <= k; i++) {
+                peers.emplace_back(new BenchPeer<message>(i));
+                directory.push_back(peers.back().get());
+            }
+            NetworkInterface<message>::setDirectory(directory, &delays);
+            BenchPeer<message> &center = *peers[0];
+            for (int i = 1; i <= k; i++) {
+                center.addNeighbor(i);
+                peers[i]->addNeighbor(0);
+            }
+            int maxDelay = distribution.second["maxDelay"];
+            LogWriter::instance()->setRound(0);
+            message msg = {};
+            auto popAll = [](BenchPeer<message> &peer) {
+                while (!peer.inStreamEmpty()) {
+                    peer.popInStream();
+                }
+            };
+            // lets every packet in flight arrive and empties the inStreams
+            auto settle = [&]() {
+                LogWriter::instance()->setRound(LogWriter::instance()->getRound() + maxDelay + 1);
+                for (auto &peer : peers) {
+                    peer->receive();
+                    popAll(*peer);
+                }
+            };
+            // a round of every leaf sending to the center
+            auto feed = [&]() {
+                for (int i = 1; i <= k; i++) {
+                    peers[i]->broadcast(msg);
+                    peers[i]->transmit();
+                }
+                LogWriter::instance()->setRound(LogWriter::instance()->getRound() + 1);
+            };
+            // the inStream of the center holding FILL_ROUNDS packets of each leaf
+            auto fill = [&]() {
+                for (int r = 0; r < FILL_ROUNDS; r++) {
+                    feed();
+                }
+                LogWriter::instance()->setRound(LogWriter::instance()->getRound() + maxDelay + 1);
+                center.receive();
+            };
+            auto nothing = []() {};
+            auto clear = [&]() {center.clearMessages();};
+
+            // the sends only fill the outStream, so a run of them is emptied at once. The center
+            // receives every round from channels as full as the distribution keeps them
+            vector<Benchmark> benchmarks = {
+                {"broadcast", nothing, [&]() {center.broadcast(msg);}, clear, 16, 1},
+                {"broadcastBut", nothing, [&]() {center.broadcastBut(msg, k / 2);}, clear, 16, 1},
+                {"unicastTo", nothing, [&]() {center.unicastTo(msg, k);}, clear, 16, 1},
+                {"randomMulticast", nothing, [&]() {center.randomMulticast(msg);}, clear, 16, 1},
+                {"popInStream", fill, [&]() {while (!center.inStreamEmpty()) sink = sink + center.popInStream().sourceId();}, nothing, 1, FILL_ROUNDS * k},
+                {"transmit", [&]() {center.broadcast(msg);}, [&]() {center.transmit();}, settle, 1, 1},
+                {"receive", feed, [&]() {center.receive();}, [&]() {popAll(center);}, 1, 1}
+            };
+            for (const Benchmark &benchmark : benchmarks) {
+                // only transmit and receive depend on the delays
+                bool delayed = benchmark.name == "transmit" || benchmark.name == "receive";
+                if (!delayed && &distribution != &distributions.front()) {
+                    continue;
+                }
+                const string &name = benchmark.name;
+                string id = name + "/" + std::to_string(k) + "/" + std::to_string(BYTES) + (delayed ? "/" + distribution.first : "");
+                if (!options.filter.empty() && id.find(options.filter) == string::npos) {
+                    continue;
+                }
+                json result = measure(options, overhead, benchmark);
+                settle();
+                result["name"] = name;
+                result["neighbors"] = k;
+                result["messageBytes"] = BYTES;
+                if (delayed) {
+                    result["distribution"] = distribution.first;
+                }
+                std::cout << std::left << std::setw(40) << id << std::right << std::setw(12) << std::fixed << std::setprecision(1) << result["median"].get<double>()
+                          << " ns  +- " << result["ci95"].get<double>() << (result["stable"].get<bool>() ? "" : "  (unstable)") << std::endl;
+                results.push_back(result);
+            }
+            NetworkInterface<message>::setDirectory({}, nullptr);
+        }
+    }
+}
+
+int main(int argc, const char* argv[]) {
+    Options options;
+    string reportFile = "microbench.json";
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--samples" && i + 1 < argc) {
+            options.samples = std::stoi(argv[++i]);
+        }
+        else if (option == "--maxSamples" && i + 1 < argc) {
+            options.maxSamples = std::stoi(argv[++i]);
+        }
+        else if (option == "--minTime" && i + 1 < argc) {
+            options.minTime = std::stod(argv[++i]) * 1e6;
+        }
+        else if (option == "--neighbors" && i + 1 < argc) {
+            options.neighbors.clear();
+            std::istringstream list(argv[++i]);
+            string k;
+            while (std::getline(list, k, ',')) {
+                options.neighbors.push_back(std::stoi(k));
+            }
+        }
+        else if (option == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        }
+        else if (i == 1 && option.compare(0, 2, "--") != 0) {
+            reportFile = option;
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [report.json] [--samples 10] [--maxSamples 30] [--minTime ms] [--neighbors 4,32,256] [--filter name]" << std::endl;
+            return 1;
+        }
+    }
+    options.maxSamples = std::max(options.maxSamples, options.samples);
+
+    double overhead = clockOverhead();
+    json report;
+    report["unit"] = "ns";
+    report["clockOverheadNs"] = overhead;
+    report["benchmarks"] = json::array();
+    run<16>(options, overhead, report["benchmarks"]);
+    run<256>(options, overhead, report["benchmarks"]);
+    run<2048>(options, overhead, report["benchmarks"]);
+
+    std::ofstream outFile(reportFile);
+    if (outFile.fail()) {
+        std::cerr << "error: cannot open output file" << std::endl;
+        return 1;
+    }
+    outFile << report.dump(2) << std::endl;
+    return 0;
+}
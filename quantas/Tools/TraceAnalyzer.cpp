@@ -0,0 +1,239 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Reads a packet trace, written by a run with "trace": {"file": "run.qtrc"}, and prints a summary:
+// the packets sent, received and dropped, by message type and on the busiest channels.
+//
+// usage: traceAnalyzer.exe input.qtrc [--chrome out.json] [--edges edges.csv] [--rounds rounds.csv] [--top N]
+//   --chrome F     writes the trace as Chrome trace event json, for chrome://tracing or Perfetto.
+//                  Each test is a process and each peer a thread; a round lasts 1ms, a send is a
+//                  slice as long as the packet's delay and receives and drops are instants
+//   --edges F      writes a csv of the packets, bytes and mean delay of every channel
+//   --rounds F     writes a csv of the packets, bytes and mean delay of every round
+//   --top N        the number of channels in the summary, 10 by default
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include "../Common/Tracer.hpp"
+
+using std::string;
+using std::vector;
+using quantas::Tracer;
+
+// what was traced on a channel or in a round
+struct Traffic {
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t dropped = 0;
+    uint64_t bytes = 0;
+    uint64_t delay = 0;
+
+    void add(const Tracer::Record &record) {
+        if (record.event == Tracer::SEND) {
+            sent++;
+            bytes += record.size;
+            delay += record.delay;
+        }
+        else if (record.event == Tracer::RECEIVE) {
+            received++;
+        }
+        else {
+            dropped++;
+        }
+    }
+    double meanDelay() const { return sent ? double(delay) / sent : 0; }
+};
+
+std::ostream& operator<<(std::ostream &out, const Traffic &traffic) {
+    return out << traffic.sent << "," << traffic.received << "," << traffic.dropped << "," << traffic.bytes << "," << traffic.meanDelay();
+}
+
+string jsonString(const string &text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            quoted += ' ';
+        }
+        else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+int main(int argc, const char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " input.qtrc [--chrome out.json] [--edges edges.csv] [--rounds rounds.csv] [--top N]" << std::endl;
+        return 1;
+    }
+    string chromeFile, edgesFile, roundsFile;
+    size_t top = 10;
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "--chrome" && i + 1 < argc) {
+            chromeFile = argv[++i];
+        }
+        else if (option == "--edges" && i + 1 < argc) {
+            edgesFile = argv[++i];
+        }
+        else if (option == "--rounds" && i + 1 < argc) {
+            roundsFile = argv[++i];
+        }
+        else if (option == "--top" && i + 1 < argc) {
+            top = std::stoul(argv[++i]);
+        }
+        else {
+            std::cerr << "error: unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream inFile(argv[1], std::ios::binary);
+    if (inFile.fail()) {
+        std::cerr << "error: cannot open input file" << std::endl;
+        return 1;
+    }
+    uint32_t header[3];
+    if (!inFile.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != Tracer::MAGIC || header[1] != Tracer::VERSION) {
+        std::cerr << "error: " << argv[1] << " is not a QUANTAS trace file" << std::endl;
+        return 1;
+    }
+    if (header[2] != sizeof(Tracer::Record)) {
+        std::cerr << "error: " << argv[1] << " has records of " << header[2] << " bytes, expected " << sizeof(Tracer::Record) << std::endl;
+        return 1;
+    }
+
+    std::ofstream chrome;
+    if (!chromeFile.empty()) {
+        chrome.open(chromeFile);
+        if (chrome.fail()) {
+            std::cerr << "error: cannot open " << chromeFile << std::endl;
+            return 1;
+        }
+        chrome << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    }
+    bool firstEvent = true;
+    auto event = [&](const string &text) {
+        chrome << (firstEvent ? "" : ",\n") << text;
+        firstEvent = false;
+    };
+
+    vector<string> tags;
+    std::unordered_map<uint64_t, Traffic> edges;
+    std::map<std::pair<int32_t, int32_t>, Traffic> rounds;
+    vector<Traffic> types;
+    std::map<int32_t, bool> tests;
+    Traffic total;
+    vector<Tracer::Record> records;
+    uint32_t block[2];
+    while (inFile.read(reinterpret_cast<char*>(block), sizeof(block))) {
+        uint32_t count = block[1];
+        if (block[0] == Tracer::TAGS) {
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t entry[2];
+                inFile.read(reinterpret_cast<char*>(entry), sizeof(entry));
+                string name(entry[1], '\0');
+                inFile.read(&name[0], entry[1]);
+                if (tags.size() <= entry[0]) {
+                    tags.resize(entry[0] + 1);
+                }
+                tags[entry[0]] = name.empty() ? "message" : name;
+            }
+        }
+        else if (block[0] == Tracer::RECORDS) {
+            records.resize(count);
+            if (!inFile.read(reinterpret_cast<char*>(records.data()), count * sizeof(Tracer::Record))) {
+                break;
+            }
+            for (const Tracer::Record &record : records) {
+                const string &type = record.type < tags.size() ? tags[record.type] : std::to_string(record.type);
+                total.add(record);
+                edges[uint64_t(uint32_t(record.source)) << 32 | uint32_t(record.target)].add(record);
+                rounds[{record.test, record.round}].add(record);
+                if (types.size() <= record.type) {
+                    types.resize(record.type + 1);
+                }
+                types[record.type].add(record);
+                if (chrome.is_open()) {
+                    if (!tests[record.test]) {
+                        event("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(record.test) + ",\"args\":{\"name\":\"test " + std::to_string(record.test) + "\"}}");
+                    }
+                    string common = "\"name\":" + jsonString(type) + ",\"pid\":" + std::to_string(record.test) + ",\"ts\":" + std::to_string(int64_t(record.round) * 1000);
+                    if (record.event == Tracer::SEND) {
+                        event("{" + common + ",\"cat\":\"send\",\"ph\":\"X\",\"dur\":" + std::to_string(int64_t(std::max(record.delay, 1)) * 1000) + ",\"tid\":" + std::to_string(record.source)
+                            + ",\"args\":{\"target\":" + std::to_string(record.target) + ",\"delay\":" + std::to_string(record.delay) + ",\"size\":" + std::to_string(record.size) + "}}");
+                    }
+                    else if (record.event == Tracer::RECEIVE) {
+                        event("{" + common + ",\"cat\":\"receive\",\"ph\":\"i\",\"s\":\"t\",\"tid\":" + std::to_string(record.target) + ",\"args\":{\"source\":" + std::to_string(record.source) + "}}");
+                    }
+                    else {
+                        event("{" + common + ",\"cat\":\"drop\",\"ph\":\"i\",\"s\":\"t\",\"tid\":" + std::to_string(record.source) + ",\"args\":{\"target\":" + std::to_string(record.target) + "}}");
+                    }
+                }
+                tests[record.test] = true;
+            }
+        }
+        else {
+            std::cerr << "error: unknown block " << block[0] << std::endl;
+            return 1;
+        }
+    }
+    if (!inFile.eof()) {
+        std::cerr << "error: " << argv[1] << " is truncated" << std::endl;
+        return 1;
+    }
+    if (chrome.is_open()) {
+        chrome << "\n]}\n";
+    }
+
+    if (!edgesFile.empty()) {
+        vector<std::pair<uint64_t, Traffic>> sorted(edges.begin(), edges.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+        std::ofstream out(edgesFile);
+        out << "source,target,sent,received,dropped,bytes,meanDelay\n";
+        for (auto &edge : sorted) {
+            out << int32_t(edge.first >> 32) << "," << int32_t(edge.first & 0xffffffff) << "," << edge.second << "\n";
+        }
+    }
+    if (!roundsFile.empty()) {
+        std::ofstream out(roundsFile);
+        out << "test,round,sent,received,dropped,bytes,meanDelay\n";
+        for (auto &round : rounds) {
+            out << round.first.first << "," << round.first.second << "," << round.second << "\n";
+        }
+    }
+
+    std::cout << "packets sent " << total.sent << ", received " << total.received << ", dropped " << total.dropped << ", " << total.bytes << " bytes, mean delay " << total.meanDelay() << std::endl;
+    std::cout << tests.size() << " tests, " << rounds.size() << " rounds, " << edges.size() << " channels" << std::endl;
+    std::cout << "by type (sent, received, dropped, bytes, mean delay):" << std::endl;
+    for (size_t t = 0; t < types.size(); t++) {
+        if (types[t].sent + types[t].received + types[t].dropped > 0) {
+            std::cout << "  " << (t < tags.size() ? tags[t] : std::to_string(t)) << "," << types[t] << std::endl;
+        }
+    }
+    vector<std::pair<uint64_t, Traffic>> busiest(edges.begin(), edges.end());
+    top = std::min(top, busiest.size());
+    std::partial_sort(busiest.begin(), busiest.begin() + top, busiest.end(), [](const auto &a, const auto &b) {
+        return a.second.sent != b.second.sent ? a.second.sent > b.second.sent : a.first < b.first;
+    });
+    std::cout << "busiest channels (source, target, sent, received, dropped, bytes, mean delay):" << std::endl;
+    for (size_t i = 0; i < top; i++) {
+        std::cout << "  " << int32_t(busiest[i].first >> 32) << "," << int32_t(busiest[i].first & 0xffffffff) << "," << busiest[i].second << std::endl;
+    }
+    return 0;
+}
@@ -19,10 +19,14 @@
 #include <set>
 #include <chrono>
 #include <random>
+#include <memory>
 
 #include "Common/Network.hpp"
 #include "Common/NetworkInterface.hpp"
 #include "Common/Simulation.hpp"
+#include "Common/Sweep.hpp"
+#include "Common/ResultCache.hpp"
+#include "Common/ThreadScaling.hpp"
 #include "Common/Json.hpp"
 
 using nlohmann::json;
@@ -43,11 +47,50 @@ int main(int argc, const char* argv[]) {
    json config;
    inFile >> config;
 
+   // experiments that have been run before by the same executable are read from the cache
+   std::unique_ptr<quantas::ResultCache> cache;
+   if (config.contains("cache")) {
+      cache.reset(new quantas::ResultCache(config["cache"]));
+   }
+
    for (int i = 0; i < config["experiments"].size(); ++i) {
       json input = config["experiments"][i];
+      // an experiment measuring how it scales is run once per thread count, each in a process of its own
+      if (input.contains("threadScaling")) {
+         quantas::ThreadScaling scaling(input);
+         scaling.run([](json experiment) {
+            quantas::SimWrapper* sim = quantas::generateSim();
+            sim->run(experiment);
+            delete sim;
+         });
+         continue;
+      }
+      std::string key;
+      if (cache && quantas::ResultCache::cacheable(input) && input["logFile"] != "cout") {
+         key = cache->key(input);
+         json log;
+         if (cache->load(key, log)) {
+            quantas::ResultCache::writeLog(input["logFile"], log);
+            continue;
+         }
+      }
       quantas::SimWrapper* sim = quantas::generateSim();
 	   sim->run(input);
       delete sim;
+      json log;
+      if (!key.empty() && quantas::ResultCache::readLog(input["logFile"], log)) {
+         cache->store(key, log);
+      }
+   }
+
+   // a sweep runs each of the experiments it expands to in a process of its own
+   if (config.contains("sweep")) {
+      quantas::Sweep sweep(config["sweep"]);
+      sweep.run([](json input) {
+         quantas::SimWrapper* sim = quantas::generateSim();
+         sim->run(input);
+         delete sim;
+      }, cache.get());
    }
 
    return 0;